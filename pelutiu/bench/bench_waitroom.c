@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+#include "waitroom.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// --- Waiting room handoff benchmark ---
+// Producers play arriving clients: each one takes a free chair (an atomic
+// counter, like free_chairs in pelutiu) and puts a client in the waiting room.
+// Barbers take clients and give the chair back right away, without cutting,
+// so the run measures only the handoff. Latency is put -> take per client.
+//
+// Uso: bench_waitroom [traspasos] [productores] [sillas]
+
+#define SENTINEL ((void *) UINTPTR_MAX) // Tells a barber to go home
+
+static const int barber_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static Waitroom room;
+static long n_handoffs;
+static int n_producers;
+static int free_chairs;
+static long next_client;
+static double *put_time;  // Per client, written before the put
+static double *latency;   // Per client, written by the barber that took it
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void take_chair(void) {
+    int chairs = __atomic_load_n(&free_chairs, __ATOMIC_RELAXED);
+    while (1) {
+        if (chairs == 0) {
+            sched_yield();
+            chairs = __atomic_load_n(&free_chairs, __ATOMIC_RELAXED);
+        } else if (__atomic_compare_exchange_n(&free_chairs, &chairs, chairs - 1, 1,
+                                               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+static void *producer(void *arg) {
+    (void) arg;
+    while (1) {
+        long id = __atomic_fetch_add(&next_client, 1, __ATOMIC_RELAXED);
+        if (id >= n_handoffs) {
+            return NULL;
+        }
+        take_chair();
+        put_time[id] = now_us();
+        waitroom_put(&room, (void *) (uintptr_t) (id + 1)); // Never NULL
+    }
+}
+
+static void *barber(void *arg) {
+    (void) arg;
+    while (1) {
+        void *client = waitroom_take(&room);
+        double t = now_us();
+        __atomic_add_fetch(&free_chairs, 1, __ATOMIC_RELEASE);
+        if (client == SENTINEL) {
+            return NULL;
+        }
+        long id = (long) (uintptr_t) client - 1;
+        latency[id] = t - put_time[id];
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Runs one configuration; returns handoffs per second and fills p50/p99
+static double run(WaitroomKind kind, int n_barbers, int n_chairs, double *p50, double *p99) {
+    if (waitroom_init(&room, kind, n_chairs) != 0) {
+        fprintf(stderr, "Error: Memoria insuficiente.\n");
+        exit(1);
+    }
+    free_chairs = n_chairs;
+    next_client = 0;
+
+    pthread_t barbers[n_barbers];
+    pthread_t producers[n_producers];
+    double start = now_us();
+    for (int i = 0; i < n_barbers; i++) {
+        pthread_create(&barbers[i], NULL, barber, NULL);
+    }
+    for (int i = 0; i < n_producers; i++) {
+        pthread_create(&producers[i], NULL, producer, NULL);
+    }
+    for (int i = 0; i < n_producers; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    // Every client is seated or taken: one sentinel per barber closes the shop
+    for (int i = 0; i < n_barbers; i++) {
+        take_chair();
+        waitroom_put(&room, SENTINEL);
+    }
+    for (int i = 0; i < n_barbers; i++) {
+        pthread_join(barbers[i], NULL);
+    }
+    double elapsed = now_us() - start;
+    waitroom_destroy(&room);
+
+    qsort(latency, n_handoffs, sizeof(double), compare_double);
+    *p50 = latency[n_handoffs / 2];
+    *p99 = latency[n_handoffs * 99 / 100];
+    return n_handoffs / (elapsed / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    n_handoffs = argc > 1 ? atol(argv[1]) : 200000;
+    n_producers = argc > 2 ? atoi(argv[2]) : 2;
+    int n_chairs = argc > 3 ? atoi(argv[3]) : 20;
+    if (n_handoffs <= 0 || n_producers <= 0 || n_chairs <= 0) {
+        fprintf(stderr, "Uso: bench_waitroom [traspasos] [productores] [sillas]\n");
+        return 1;
+    }
+    put_time = malloc(n_handoffs * sizeof(double));
+    latency = malloc(n_handoffs * sizeof(double));
+    if (put_time == NULL || latency == NULL) {
+        fprintf(stderr, "Error: Memoria insuficiente.\n");
+        return 1;
+    }
+
+    printf("%ld traspasos, %d productores, %d sillas\n", n_handoffs, n_producers, n_chairs);
+    printf("%-11s %-15s %14s %10s %10s\n", "peluqueros", "implementación", "traspasos/s", "p50 µs", "p99 µs");
+    for (int i = 0; i < (int) (sizeof(barber_counts) / sizeof(barber_counts[0])); i++) {
+        for (int k = WAITROOM_LOCKED; k <= WAITROOM_LOCKFREE; k++) {
+            double p50, p99;
+            double rate = run((WaitroomKind) k, barber_counts[i], n_chairs, &p50, &p99);
+            printf("%-11d %-15s %14.0f %10.1f %10.1f\n", barber_counts[i],
+                   waitroom_kind_name((WaitroomKind) k), rate, p50, p99);
+            fflush(stdout);
+        }
+    }
+    free(put_time);
+    free(latency);
+    return 0;
+}
@@ -1,266 +1,1090 @@
+#define _POSIX_C_SOURCE 200809L // For nanosleep
 #include <ncurses.h>
+#include <errno.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <unistd.h>
-#include <time.h> // For nanosleep
+#include <time.h>
+
+#include "sim.h"
+#include "stats.h"
+#include "sweep.h"
+#include "waitroom.h"
+#include "workload.h"
 
 // --- Constants and Structures ---
 #define MAX_NAME_LEN 30
 #define PROMPT_HEIGHT 3
 #define STATUS_HEIGHT 15 // Not strictly used for fixed height, but for general status area
+#define WORKER_THREADS 2  // Threads that run the client state machines
+#define CLIENT_SLAB 1024  // Client records allocated at a time by the pool
+#define CLIENTS_MAX 1000000 // Default cap on client records (--max-clients)
+#define RENDER_FPS 30     // Most frames per second the render thread draws
+#define ROW_LEN 320       // One formatted status row
+#define OUTSIDE_SHOWN 100 // Names of clients outside kept for the screen (a line holds fewer)
+#define INPUT_LEN 100     // Longest line typed at the prompt
+#define MESSAGE_SECS 1.0  // How long an error stays under the prompt
+#define BARBER_STACK (256 * 1024) // Barbers need little stack: thousands of them fit
+#define SWEEP_MAX 64      // Values in each comma-separated list of --sweep
+
+// A client is a small state machine instead of a thread. Each transition is a
+// short, non-blocking step run by one of the worker threads:
+//   ARRIVING -> SEATED   a chair was free
+//   ARRIVING -> OUTSIDE  every chair taken: join the outside queue
+//   OUTSIDE  -> SEATED   a barber freed a chair and reserved it for us (and
+//                        already showed us in it)
+//   SEATED   -> CUTTING  (done by the barber that takes the client)
+//   CUTTING  -> DONE     haircut finished: the record goes back to the pool
+typedef enum {
+    CLIENT_ARRIVING,
+    CLIENT_OUTSIDE,
+    CLIENT_SEATED,
+    CLIENT_CUTTING,
+    CLIENT_DONE,
+} ClientState;
 
 // Structure to hold client information in the waiting room
-typedef struct {
+typedef struct ClientData {
     char name[MAX_NAME_LEN];
-    int haircut_time; // Time in seconds
+    double haircut_time; // Time in seconds
     int barber_id;    // Which barber is cutting this client's hair
+    int chair;        // Slot in shop_view.waiting while seated
+    ClientState state;
+    double arrived;   // now_seconds() when the client walked in
+    double started;   // now_seconds() when a barber took the client
+    struct ClientData *next; // Link in the work queue, the outside queue or the pool
 } ClientData;
 
+// Per-barber state. Each barber writes only its own record, and records are
+// a cache line apart, so thousands of barbers never invalidate each other's
+// lines (false sharing).
+typedef struct {
+    int id;
+    long served;      // Haircuts finished; read without locking by the renderer
+    double busy;      // Seconds spent cutting (protected by mutex_stats)
+    pthread_t tid;
+} __attribute__((aligned(64))) Barber;
+
 // --- Global State Variables ---
 WINDOW *main_win;
 WINDOW *input_win;
 int N_BARBERS;          // Number of barbers
 int M_WAITING_CHAIRS;   // Number of waiting chairs
-int clients_waiting_outside_count = 0; // Count of clients who couldn't find a chair
 
-// Shared buffer for waiting chairs (circular buffer)
-ClientData waiting_room[20]; // Max capacity, should be >= M_WAITING_CHAIRS
-int waiting_in = 0;  // Index for adding clients
-int waiting_out = 0; // Index for barbers taking clients
+// Seated clients waiting for a barber (see waitroom.h; --waitroom picks the
+// implementation)
+Waitroom waiting_room;
+int free_chairs;     // Chairs neither occupied nor reserved for a client outside
+
+Barber *barbers;     // N_BARBERS records
+
+// Clients waiting outside, in arrival order (protected by mutex_access_chairs).
+// There is no limit: a list through the client records, O(1) at both ends.
+ClientData *outside_first = NULL;
+ClientData **outside_last = &outside_first;
+ClientData *outside_shown_last = NULL; // Last client outside whose name is in shop_view.afuera
+
+// Client steps waiting for a worker thread
+ClientData *work_first = NULL;
+ClientData **work_last = &work_first;
 
-// Lists for TUI display
-char display_waiting[20][MAX_NAME_LEN]; // Clients in waiting chairs
-char display_cutting[20][MAX_NAME_LEN]; // Clients currently being cut
-char display_afuera[100][MAX_NAME_LEN]; // Clients waiting outside
+// Free client records; the pool grows by CLIENT_SLAB records up to
+// client_cap and never shrinks, so memory is bounded by the cap
+ClientData *client_pool = NULL;
+long client_cap = CLIENTS_MAX;  // Most client records the pool hands out
+long client_records = 0;        // Records allocated so far (protected by mutex_pool)
+
+// What the screen shows. Barbers and workers change it between view_begin()
+// and view_end(), a short critical section without terminal I/O; the render
+// thread copies it without taking any lock (see view_snapshot). The arrays
+// are sized at start and never freed, so a copy never reads freed memory.
+typedef struct {
+    int outside_count;              // Clients who couldn't find a chair
+    int outside_head;               // Slot in afuera of the first client outside
+    int seated;
+    int busy_barbers;
+    char (*waiting)[MAX_NAME_LEN];  // One slot per chair (client->chair)
+    char (*cutting)[MAX_NAME_LEN];  // One slot per barber
+    char afuera[OUTSIDE_SHOWN][MAX_NAME_LEN]; // Ring: the first clients outside
+} ShopView;
+
+ShopView shop_view;
+int *free_slots;        // Stack of free slots in shop_view.waiting (writers only)
+int n_free_slots;
+unsigned view_seq = 0;  // Seqlock: odd while shop_view is being changed
+int render_stop = 0;    // Set by main to end the render thread
+
+// The prompt. The render thread owns the terminal: it reads the keys, echoes
+// them and hands each finished line to main, which only parses it
+// (protected by mutex_input).
+char input_line[INPUT_LEN];
+int input_ready = 0;              // input_line holds a line main hasn't taken
+const char* input_message = NULL; // Error for the render thread to show
+long feeder_error = 0;  // Malformed trace record that stopped the feeder, if any
+int feeder_stop = 0;    // Set by main on exit (protected by mutex_feeder; the pool reads it atomically)
+int work_stop = 0;      // Set by main on exit: workers drain the queue and end (mutex_work)
+
+// What the session measured, printed on exit (protected by mutex_stats)
+typedef struct {
+    double start;       // now_seconds() when the shop opened
+    Histogram wait;     // Arrival -> a barber takes the client
+    Histogram service;  // The haircut
+    Histogram sojourn;  // Arrival -> leaving
+} SessionStats;
+
+SessionStats session;
 
 // --- Synchronization Mechanisms ---
-sem_t sem_customers;    // Counts customers in the waiting room (barbers wait on this)
-sem_t sem_barbers;      // Counts available barbers (customers wait on this)
-sem_t sem_waiting_chairs; // Counts available waiting chairs (customers wait on this)
-pthread_mutex_t mutex_access_chairs; // Mutex for accessing waiting_room and related counters
-pthread_mutex_t mutex_ncurses;       // Mutex for all ncurses operations and display lists
+pthread_mutex_t mutex_access_chairs; // Mutex for free_chairs and the outside queue; taken before mutex_view
+pthread_mutex_t mutex_view;          // Serializes the writers of shop_view
+pthread_mutex_t mutex_work;          // Mutex for the work queue
+pthread_cond_t cond_work;            // Signaled when a step is queued
+pthread_mutex_t mutex_pool;          // Mutex for client_pool and client_records
+pthread_cond_t cond_pool;            // Signaled when a record goes back to the pool
+pthread_mutex_t mutex_stats;         // Mutex for session and Barber.busy
+pthread_mutex_t mutex_feeder;        // Mutex for feeder_stop
+pthread_cond_t cond_feeder;          // Wakes the feeder early to stop it (CLOCK_MONOTONIC)
+pthread_mutex_t mutex_input;         // Mutex for input_line, input_ready and input_message
+pthread_cond_t cond_input;           // Signaled when a line is ready
+
+double now_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// --- Shop View ---
+// Allocates the per-chair and per-barber arrays of a view. Returns -1 if out
+// of memory.
+int view_alloc(ShopView *view) {
+    view->waiting = calloc(M_WAITING_CHAIRS, MAX_NAME_LEN);
+    view->cutting = calloc(N_BARBERS, MAX_NAME_LEN);
+    return view->waiting != NULL && view->cutting != NULL ? 0 : -1;
+}
+
+void view_begin() {
+    pthread_mutex_lock(&mutex_view);
+    __atomic_store_n(&view_seq, view_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void view_end() {
+    __atomic_store_n(&view_seq, view_seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mutex_view);
+}
+
+// Copies shop_view as of one moment between changes; a copy that overlapped a
+// change is retried. Returns the sequence number of the copy.
+unsigned view_snapshot(ShopView *copy) {
+    while (1) {
+        unsigned seq = __atomic_load_n(&view_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            sched_yield(); // A writer is in the middle of a change (a few stores)
+            continue;
+        }
+        copy->outside_count = shop_view.outside_count;
+        copy->outside_head = shop_view.outside_head;
+        copy->seated = shop_view.seated;
+        copy->busy_barbers = shop_view.busy_barbers;
+        memcpy(copy->waiting, shop_view.waiting, (size_t) M_WAITING_CHAIRS * MAX_NAME_LEN);
+        memcpy(copy->cutting, shop_view.cutting, (size_t) N_BARBERS * MAX_NAME_LEN);
+        memcpy(copy->afuera, shop_view.afuera, sizeof(copy->afuera));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&view_seq, __ATOMIC_RELAXED) == seq) {
+            return seq;
+        }
+    }
+}
 
 // --- TUI (ncurses) Functions ---
-void draw_main_window(WINDOW *win) {
-    // This function MUST be called within pthread_mutex_lock/unlock(&mutex_ncurses)
+// Writes "name, name, ..." into buf, or `none` if no name is set. Takes
+// `count` slots of the ring `names` (n slots) from `start`, and stops as soon
+// as the line is full, however many slots there are.
+void join_names(char *buf, int size, char names[][MAX_NAME_LEN], int n, int start, int count,
+                const char *none) {
+    int current_len = 0;
+    for (int i = 0; i < count && current_len < size; i++) {
+        const char *name = names[(start + i) % n];
+        if (name[0] != '\0') {
+            current_len += snprintf(buf + current_len, size - current_len, "%s, ", name);
+        }
+    }
+    if (current_len >= size) {
+        current_len = size - 1; // Truncated: too many names for one line
+    }
+    if (current_len >= 2) {
+        buf[current_len - 2] = '\0'; // Remove trailing comma and space
+    } else {
+        snprintf(buf, size, "%s", none);
+    }
+}
+
+// Formats the status rows (count and names) of a snapshot
+void format_rows(ShopView *view, long served, char rows[4][ROW_LEN]) {
+    char names[256];
+    char count[32];
+
+    // ESPERANDO (Afuera). Only the first OUTSIDE_SHOWN names are kept; they
+    // fill the line long before that
+    int shown = view->outside_count < OUTSIDE_SHOWN ? view->outside_count : OUTSIDE_SHOWN;
+    join_names(names, sizeof(names), view->afuera, OUTSIDE_SHOWN, view->outside_head, shown, "Nadie");
+    snprintf(count, sizeof(count), "%d:", view->outside_count);
+    snprintf(rows[0], ROW_LEN, "%-13s%s", count, names);
+
+    // SENTADOS
+    join_names(names, sizeof(names), view->waiting, M_WAITING_CHAIRS, 0, M_WAITING_CHAIRS, "Nadie");
+    snprintf(count, sizeof(count), "%d / %d:", view->seated, M_WAITING_CHAIRS);
+    snprintf(rows[1], ROW_LEN, "%-13s%s", count, names);
+
+    // CORTANDO
+    join_names(names, sizeof(names), view->cutting, N_BARBERS, 0, N_BARBERS, "Nadie");
+    snprintf(count, sizeof(count), "%d / %d:", view->busy_barbers, N_BARBERS);
+    snprintf(rows[2], ROW_LEN, "%-13s%s", count, names);
+
+    // ATENDIDOS
+    snprintf(rows[3], ROW_LEN, "%ld", served);
+}
+
+// Frame, title and section labels: drawn once, they never change
+void draw_static(WINDOW *win) {
     werase(win);
     box(win, 0, 0);
-    
-    int current_len; // Declare once
-
-    // Title
     mvwprintw(win, 0, (COLS - strlen("PELUTIU - PELUQUERIA INTERACTIVA (v2)")) / 2, "PELUTIU - PELUQUERIA INTERACTIVA (v2)");
-
-    // Section ESPERANDO (Afuera)
     mvwprintw(win, 2, 2, "ESPERANDO (Afuera):");
-    mvwprintw(win, 3, 2, "%d:", clients_waiting_outside_count);
+    mvwprintw(win, 5, 2, "SENTADOS:");
+    mvwprintw(win, 8, 2, "CORTANDO:");
+    mvwprintw(win, 11, 2, "ATENDIDOS:");
+}
+
+// Rewrites one status row, cut at the right border
+void draw_row(WINDOW *win, int y, const char *text) {
+    int width = getmaxx(win);
+    wmove(win, y, 1);
+    wclrtoeol(win);
+    mvwprintw(win, y, 2, "%.*s", width > 3 ? width - 3 : 0, text);
+    mvwaddch(win, y, width - 1, ACS_VLINE); // wclrtoeol erased the border
+}
+
+// The prompt, with the line typed so far and, under it, the last error
+void draw_input(WINDOW *win, const char *line, const char *message) {
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 2, 2, "%s", message);
+    mvwprintw(win, 1, 2, "Ingress Cliente: %s", line); // Leaves the cursor after the line
+}
+
+// --- Render Thread ---
+// The only thread that touches the terminal (ncurses is not thread-safe). At
+// most RENDER_FPS times per second it takes a snapshot of shop_view (if it
+// changed) and rewrites only the rows whose text changed, so barbers and
+// workers never wait for the terminal and a burst of events costs one frame.
+// Between frames it waits for keys in the prompt.
+void* render_thread(void* arg) {
+    ShopView *view = arg;          // The thread's copy, allocated by main
+    static const int row_y[4] = { 3, 6, 9, 12 };
+    char rows[4][ROW_LEN];
+    char drawn[4][ROW_LEN];
+    int first = 1;
+    unsigned drawn_seq = 0;
+    char line[INPUT_LEN] = "";
+    int len = 0;
+    char message[ROW_LEN] = "";
+    double message_until = 0;
+    int input_changed = 1;
+    double next_frame = 0;
+
+    while (!__atomic_load_n(&render_stop, __ATOMIC_RELAXED)) {
+        double now = now_seconds();
+        if (now >= next_frame) {
+            next_frame = now + 1.0 / RENDER_FPS;
+
+            // 1. The shop, if it changed
+            if (first || __atomic_load_n(&view_seq, __ATOMIC_ACQUIRE) != drawn_seq) {
+                drawn_seq = view_snapshot(view);
+                // Every haircut also changes the view, so the sum is redrawn in time
+                long served = 0;
+                for (int i = 0; i < N_BARBERS; i++) {
+                    served += __atomic_load_n(&barbers[i].served, __ATOMIC_RELAXED);
+                }
+                format_rows(view, served, rows);
 
-    char afuera_str[256] = "";
-    current_len = 0;
-    for (int i = 0; i < clients_waiting_outside_count; i++) {
-        if (strlen(display_afuera[i]) > 0) {
-            current_len += snprintf(afuera_str + current_len, sizeof(afuera_str) - current_len, "%s, ", display_afuera[i]);
+                if (first) {
+                    draw_static(main_win);
+                }
+                for (int r = 0; r < 4; r++) {
+                    if (first || strcmp(rows[r], drawn[r]) != 0) {
+                        draw_row(main_win, row_y[r], rows[r]);
+                        strcpy(drawn[r], rows[r]);
+                    }
+                }
+                wnoutrefresh(main_win);
+                first = 0;
+            }
+
+            // 2. Errors from main, shown for MESSAGE_SECS
+            pthread_mutex_lock(&mutex_input);
+            if (input_message != NULL) {
+                snprintf(message, sizeof(message), "%s", input_message);
+                input_message = NULL;
+                message_until = now + MESSAGE_SECS;
+                input_changed = 1;
+            }
+            pthread_mutex_unlock(&mutex_input);
+            if (message[0] != '\0' && now >= message_until) {
+                message[0] = '\0';
+                input_changed = 1;
+            }
+        }
+
+        // 3. The prompt goes last, so the cursor ends up in it
+        if (input_changed) {
+            draw_input(input_win, line, message);
+            input_changed = 0;
+        }
+        wnoutrefresh(input_win);
+        doupdate();
+
+        // 4. Keys until the next frame. While main hasn't taken the last line,
+        //    new keys wait in the terminal.
+        int wait_ms = (int) ((next_frame - now_seconds()) * 1000) + 1;
+        pthread_mutex_lock(&mutex_input);
+        int line_pending = input_ready;
+        pthread_mutex_unlock(&mutex_input);
+        if (line_pending) {
+            struct timespec pause = { 0, wait_ms * 1000000L };
+            nanosleep(&pause, NULL);
+            continue;
         }
+        wtimeout(input_win, wait_ms);
+        int key = wgetch(input_win);
+        if (key == ERR) {
+            continue;
+        }
+        if (key == '\n' || key == '\r' || key == KEY_ENTER) {
+            pthread_mutex_lock(&mutex_input);
+            strcpy(input_line, line);
+            input_ready = 1;
+            pthread_cond_signal(&cond_input);
+            pthread_mutex_unlock(&mutex_input);
+            len = 0;
+        } else if (key == KEY_BACKSPACE || key == 127 || key == '\b') {
+            if (len > 0) {
+                len--;
+            }
+        } else if (key >= ' ' && key < 256 && len < INPUT_LEN - 1) {
+            line[len++] = (char) key;
+        }
+        line[len] = '\0';
+        input_changed = 1;
     }
-    if (clients_waiting_outside_count > 0) {
-        afuera_str[current_len - 2] = '\0'; // Remove trailing comma and space
-    } else {
-        snprintf(afuera_str, sizeof(afuera_str), "Nadie");
+    return NULL;
+}
+
+// --- Client Pool ---
+// Client records come from a free list refilled a slab at a time, so a burst
+// of arrivals costs one malloc per CLIENT_SLAB clients instead of one per client.
+// No more than client_cap records are ever allocated. Called with mutex_pool.
+static int client_refill() {
+    long n = client_cap - client_records;
+    if (n <= 0) {
+        errno = EAGAIN; // The shop is full
+        return -1;
     }
-    mvwprintw(win, 3, 15, "%s", afuera_str);
+    if (n > CLIENT_SLAB) {
+        n = CLIENT_SLAB;
+    }
+    ClientData* slab = malloc(n * sizeof(ClientData));
+    if (slab == NULL) {
+        return -1; // errno is ENOMEM
+    }
+    for (long i = 0; i < n; i++) {
+        slab[i].next = client_pool;
+        client_pool = &slab[i];
+    }
+    client_records += n;
+    return 0;
+}
 
-    // Section SENTADOS
-    int current_waiting_clients;
-    sem_getvalue(&sem_customers, &current_waiting_clients);
-    mvwprintw(win, 5, 2, "SENTADOS:");
-    mvwprintw(win, 6, 2, "%d / %d:", current_waiting_clients, M_WAITING_CHAIRS);
-    
-    char sentados_str[256] = "";
-    current_len = 0;
-    for (int i = 0; i < M_WAITING_CHAIRS; i++) {
-        if (strlen(display_waiting[i]) > 0) {
-            current_len += snprintf(sentados_str + current_len, sizeof(sentados_str) - current_len, "%s, ", display_waiting[i]);
+// Returns NULL with errno EAGAIN when all client_cap records are in use, or
+// ENOMEM when a slab cannot be allocated
+ClientData* client_alloc() {
+    pthread_mutex_lock(&mutex_pool);
+    if (client_pool == NULL && client_refill() != 0) {
+        pthread_mutex_unlock(&mutex_pool);
+        return NULL;
+    }
+    ClientData* client = client_pool;
+    client_pool = client->next;
+    pthread_mutex_unlock(&mutex_pool);
+    return client;
+}
+
+// Like client_alloc(), but a full shop makes the caller wait for a record to
+// be released. Returns NULL on ENOMEM or once main sets feeder_stop.
+ClientData* client_alloc_wait() {
+    pthread_mutex_lock(&mutex_pool);
+    while (client_pool == NULL && client_refill() != 0) {
+        if (errno != EAGAIN || __atomic_load_n(&feeder_stop, __ATOMIC_RELAXED)) {
+            pthread_mutex_unlock(&mutex_pool);
+            return NULL;
         }
+        pthread_cond_wait(&cond_pool, &mutex_pool);
     }
-    if (current_waiting_clients > 0) {
-        sentados_str[current_len - 2] = '\0'; // Remove trailing comma and space
-    } else {
-        snprintf(sentados_str, sizeof(sentados_str), "Nadie");
+    ClientData* client = client_pool;
+    client_pool = client->next;
+    pthread_mutex_unlock(&mutex_pool);
+    return client;
+}
+
+void client_release(ClientData* client) {
+    pthread_mutex_lock(&mutex_pool);
+    client->next = client_pool;
+    client_pool = client;
+    pthread_cond_signal(&cond_pool);
+    pthread_mutex_unlock(&mutex_pool);
+}
+
+// --- Work Queue ---
+// Queues the next steps of a list of clients (linked by next, `last` pointing
+// at the last next field) with one lock, and wakes the worker threads
+void submit_batch(ClientData* first, ClientData** last) {
+    *last = NULL;
+    pthread_mutex_lock(&mutex_work);
+    *work_last = first;
+    work_last = last;
+    pthread_cond_broadcast(&cond_work);
+    pthread_mutex_unlock(&mutex_work);
+}
+
+// Queues the next step of a client's state machine for the worker threads
+void submit_step(ClientData* client) {
+    submit_batch(client, &client->next);
+}
+
+// The view functions below must be called between view_begin() and
+// view_end(), with mutex_access_chairs held: the chair slots and the names
+// outside follow the chairs and the outside queue.
+
+// Shows a client in a free chair slot, before it is put in the waiting room
+// (a barber may take it at once). There is always a free slot: a client only
+// gets here with a chair, and a slot is released with its chair.
+void view_seat(ClientData* client) {
+    client->chair = free_slots[--n_free_slots];
+    strcpy(shop_view.waiting[client->chair], client->name);
+    shop_view.seated++;
+}
+
+void view_unseat(ClientData* client) {
+    shop_view.waiting[client->chair][0] = '\0';
+    free_slots[n_free_slots++] = client->chair;
+    shop_view.seated--;
+}
+
+// A client joined the end of the outside queue
+void view_outside_push(ClientData* client) {
+    if (shop_view.outside_count < OUTSIDE_SHOWN) {
+        int slot = (shop_view.outside_head + shop_view.outside_count) % OUTSIDE_SHOWN;
+        strcpy(shop_view.afuera[slot], client->name);
+        outside_shown_last = client;
     }
-    mvwprintw(win, 6, 15, "%s", sentados_str);
+    shop_view.outside_count++;
+}
 
-    // Section CORTANDO
-    int busy_barbers;
-    sem_getvalue(&sem_barbers, &busy_barbers); // Get value of available barbers
-    busy_barbers = N_BARBERS - busy_barbers; // Calculate busy barbers
-    mvwprintw(win, 8, 2, "CORTANDO:");
-    mvwprintw(win, 9, 2, "%d / %d:", busy_barbers, N_BARBERS);
+// The first client outside left the queue: drop its name and show the first
+// hidden client, if any. O(1) however long the queue is.
+void view_outside_pop() {
+    shop_view.outside_head = (shop_view.outside_head + 1) % OUTSIDE_SHOWN;
+    shop_view.outside_count--;
+    if (shop_view.outside_count >= OUTSIDE_SHOWN) {
+        outside_shown_last = outside_shown_last->next;
+        int slot = (shop_view.outside_head + OUTSIDE_SHOWN - 1) % OUTSIDE_SHOWN;
+        strcpy(shop_view.afuera[slot], outside_shown_last->name);
+    }
+}
 
-    char cortando_str[256] = "";
-    current_len = 0;
-    for (int i = 0; i < N_BARBERS; i++) {
-        if (strlen(display_cutting[i]) > 0) {
-            current_len += snprintf(cortando_str + current_len, sizeof(cortando_str) - current_len, "%s, ", display_cutting[i]);
+// --- Client State Machine ---
+// Runs one transition. Never blocks except on short critical sections, so a
+// couple of workers can move any number of clients.
+void client_step(ClientData* client) {
+    switch (client->state) {
+    case CLIENT_ARRIVING: {
+        // 1. Take a free chair, or join the queue outside, and update the
+        //    shop view (the render thread draws it)
+        client->arrived = now_seconds();
+        pthread_mutex_lock(&mutex_access_chairs);
+        int seated = free_chairs > 0;
+        view_begin();
+        if (seated) {
+            free_chairs--;
+            client->state = CLIENT_SEATED;
+            view_seat(client);
+        } else {
+            client->state = CLIENT_OUTSIDE;
+            client->next = NULL;
+            *outside_last = client;
+            outside_last = &client->next;
+            view_outside_push(client);
+        }
+        view_end();
+        pthread_mutex_unlock(&mutex_access_chairs);
+
+        // 2. Sit down and signal that a customer has arrived
+        if (seated) {
+            waitroom_put(&waiting_room, client);
         }
+        break;
     }
-    if (busy_barbers > 0) {
-        cortando_str[current_len - 2] = '\0'; // Remove trailing comma and space
-    } else {
-        snprintf(cortando_str, sizeof(cortando_str), "Nadie");
+
+    case CLIENT_OUTSIDE:
+        // A barber freed a chair, reserved it for this client and showed the
+        // client in it: sit down
+        client->state = CLIENT_SEATED;
+        waitroom_put(&waiting_room, client);
+        break;
+
+    case CLIENT_CUTTING:
+        // Haircut finished: the client leaves and the record is reused
+        client->state = CLIENT_DONE;
+        client_release(client);
+        break;
+
+    default:
+        break;
     }
-    mvwprintw(win, 9, 15, "%s", cortando_str);
-    
-    wrefresh(win);
+}
+
+// --- Worker Thread ---
+// Takes every queued step at once and runs them in order, so a burst of
+// arrivals costs one wakeup per batch instead of one per client.
+void* worker_thread(void* arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&mutex_work);
+        while (work_first == NULL && !work_stop) {
+            pthread_cond_wait(&cond_work, &mutex_work);
+        }
+        if (work_first == NULL) {
+            pthread_mutex_unlock(&mutex_work); // Stopping, and nothing left to run
+            return NULL;
+        }
+        ClientData* batch = work_first;
+        work_first = NULL;
+        work_last = &work_first;
+        pthread_mutex_unlock(&mutex_work);
+
+        while (batch != NULL) {
+            ClientData* client = batch;
+            batch = batch->next;
+            client_step(client);
+        }
+    }
+    return NULL;
 }
 
 // --- Barber Thread ---
 void* barber_thread(void* arg) {
-    int barber_id = *(int*)arg;
-    ClientData current_client;
+    Barber* self = arg;
+    int barber_id = self->id;
+    ClientData* current_client;
 
     while (1) {
-        // 1. Wait for a customer to arrive (sleep if no customers)
-        sem_wait(&sem_customers);
+        // 1. Take a customer from the waiting room (sleep if no customers)
+        current_client = waitroom_take(&waiting_room);
+        current_client->started = now_seconds();
+        current_client->state = CLIENT_CUTTING;
+        current_client->barber_id = barber_id;
 
-        // 2. Acquire mutex to access shared waiting room
+        // 2. Release the waiting chair: it goes to the first client outside,
+        //    who sits down in a worker step, or becomes free. Update the shop
+        //    view in the same critical section, so it follows the queue.
         pthread_mutex_lock(&mutex_access_chairs);
-
-        // 3. Take a customer from the waiting room
-        current_client = waiting_room[waiting_out];
-        waiting_out = (waiting_out + 1) % M_WAITING_CHAIRS;
-
-        // 4. Release a waiting chair
-        sem_post(&sem_waiting_chairs);
-
-        // 5. Update TUI display lists (protected by ncurses mutex)
-        pthread_mutex_lock(&mutex_ncurses);
-        strcpy(display_cutting[barber_id], current_client.name);
-        // Clear from waiting display
-        for(int i=0; i<M_WAITING_CHAIRS; i++) {
-            if(strcmp(display_waiting[i], current_client.name) == 0) {
-                display_waiting[i][0] = '\0';
-                break;
+        ClientData* next_outside = outside_first;
+        if (next_outside != NULL) {
+            outside_first = next_outside->next;
+            if (outside_first == NULL) {
+                outside_last = &outside_first;
             }
+        } else {
+            free_chairs++;
         }
-        // If not found, it means it was a client from outside who immediately took a chair
-        // This logic is a bit tricky with the current display_waiting.
-        // A simpler approach for display_waiting is to just iterate the circular buffer.
-        // For now, let's just clear the first empty slot.
-        // The current_waiting_clients calculation in draw_tui is more accurate.
-        draw_main_window(main_win);
-        pthread_mutex_unlock(&mutex_ncurses);
-
-        // 6. Release mutex for waiting room
+        view_begin();
+        view_unseat(current_client);
+        shop_view.busy_barbers++;
+        strcpy(shop_view.cutting[barber_id], current_client->name);
+        if (next_outside != NULL) {
+            view_outside_pop();
+            view_seat(next_outside);
+        }
+        view_end();
         pthread_mutex_unlock(&mutex_access_chairs);
+        if (next_outside != NULL) {
+            submit_step(next_outside);
+        }
 
-        // 7. Cut hair (simulate work)
-        sleep(current_client.haircut_time);
+        // 3. Cut hair (simulate work)
+        double secs = current_client->haircut_time;
+        struct timespec cut = { (time_t) secs, (long) ((secs - (time_t) secs) * 1e9) };
+        nanosleep(&cut, NULL);
 
-        // 8. Haircut finished. Release barber slot.
-        sem_post(&sem_barbers);
+        // 4. Haircut finished. Record the client's times and update the
+        //    shop view
+        double done = now_seconds();
+        pthread_mutex_lock(&mutex_stats);
+        hist_add(&session.wait, current_client->started - current_client->arrived);
+        hist_add(&session.service, done - current_client->started);
+        hist_add(&session.sojourn, done - current_client->arrived);
+        self->busy += done - current_client->started;
+        pthread_mutex_unlock(&mutex_stats);
+        __atomic_store_n(&self->served, self->served + 1, __ATOMIC_RELAXED);
+        view_begin();
+        shop_view.busy_barbers--;
+        shop_view.cutting[barber_id][0] = '\0'; // Clear barber's cutting slot
+        view_end();
 
-        // 9. Update TUI display (protected by ncurses mutex)
-        pthread_mutex_lock(&mutex_ncurses);
-        display_cutting[barber_id][0] = '\0'; // Clear barber's cutting slot
-        draw_main_window(main_win);
-        pthread_mutex_unlock(&mutex_ncurses);
+        // 5. The client leaves
+        submit_step(current_client);
     }
     return NULL;
 }
 
-// --- Client Thread ---
-void* client_thread(void* arg) {
-    ClientData* info = (ClientData*)arg; // Client's name and haircut time
-    int was_outside = 0;
-
-    // 1. Try to get a waiting chair
-    if (sem_trywait(&sem_waiting_chairs) != 0) {
-        // No chairs available, must wait outside.
-        was_outside = 1;
-        pthread_mutex_lock(&mutex_ncurses);
-        strcpy(display_afuera[clients_waiting_outside_count], info->name);
-        clients_waiting_outside_count++;
-        draw_main_window(main_win);
-        pthread_mutex_unlock(&mutex_ncurses);
-
-        // Blocking wait for a chair to become free
-        sem_wait(&sem_waiting_chairs);
-    }
-
-    // At this point, we have secured a waiting chair spot.
-    if (was_outside) {
-        // If we were waiting outside, update the display lists.
-        pthread_mutex_lock(&mutex_ncurses);
-        clients_waiting_outside_count--;
-        // Remove name from the display list
-        int found = 0;
-        for(int i=0; i<99; i++) {
-            if(found || strcmp(display_afuera[i], info->name) == 0) {
-                found = 1;
-                strcpy(display_afuera[i], display_afuera[i+1]);
+// --- Feeder Thread ---
+// Replays a workload (--trace or --arrivals) in real time next to the typed
+// clients. Everyone due by the time the feeder wakes up (a group of a bursty
+// workload, or several arrivals closer together than the timer) is queued
+// for the workers as one batch.
+void* feeder_thread(void* arg) {
+    Workload* workload = arg;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Arrival arrival;
+    int more = workload_next(workload, &arrival);
+    while (more == 1) {
+        // 1. Sleep until the next client is due
+        struct timespec due = start;
+        due.tv_sec += (time_t) arrival.time;
+        due.tv_nsec += (long) ((arrival.time - (time_t) arrival.time) * 1e9);
+        if (due.tv_nsec >= 1000000000L) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000L;
+        }
+        // A wait on a condition instead of a sleep, so main can stop the
+        // feeder however far away the next client is
+        pthread_mutex_lock(&mutex_feeder);
+        while (!feeder_stop &&
+               pthread_cond_timedwait(&cond_feeder, &mutex_feeder, &due) != ETIMEDOUT) {
+        }
+        int stop = feeder_stop;
+        pthread_mutex_unlock(&mutex_feeder);
+        if (stop) {
+            break;
+        }
+
+        // 2. Collect every client due by now
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+        ClientData* first = NULL;
+        ClientData** last = &first;
+        while (more == 1 && arrival.time <= elapsed) {
+            ClientData* info = client_alloc();
+            if (info == NULL && errno == EAGAIN) {
+                // The shop is full: hand over what is collected (it may hold
+                // the records) and wait for a client to leave
+                if (first != NULL) {
+                    submit_batch(first, last);
+                    first = NULL;
+                    last = &first;
+                }
+                info = client_alloc_wait();
+            }
+            if (info == NULL) {
+                more = 0; // Out of memory or stopped: stop feeding
+                break;
             }
+            strcpy(info->name, arrival.name);
+            info->haircut_time = arrival.haircut;
+            info->state = CLIENT_ARRIVING;
+            *last = info;
+            last = &info->next;
+            more = workload_next(workload, &arrival);
         }
-        display_afuera[99][0] = '\0';
-        draw_main_window(main_win);
-        pthread_mutex_unlock(&mutex_ncurses);
-    }
 
-    // 2. Acquire mutex to access shared waiting room
-    pthread_mutex_lock(&mutex_access_chairs);
-    // 3. Place client in waiting room
-    waiting_room[waiting_in] = *info;
-    waiting_in = (waiting_in + 1) % M_WAITING_CHAIRS;
-    pthread_mutex_unlock(&mutex_access_chairs);
+        // 3. Hand the batch to the worker threads
+        if (first != NULL) {
+            submit_batch(first, last);
+        }
+    }
+    if (more < 0) {
+        __atomic_store_n(&feeder_error, workload->record, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
 
-    // 6. Signal that a customer has arrived
-    sem_post(&sem_customers);
+// --- Session Summary ---
+// Printed after endwin(). Barbers may still be cutting: clients are counted
+// once their haircut ends.
+void print_session() {
+    pthread_mutex_lock(&mutex_stats);
+    double elapsed = now_seconds() - session.start;
+    Histogram utilization;
+    hist_init(&utilization);
+    for (int i = 0; i < N_BARBERS; i++) {
+        hist_add(&utilization, elapsed > 0 ? barbers[i].busy / elapsed : 0.0);
+    }
+    printf("Sesión: %d peluqueros, %d sillas, %.1f s, %ld atendidos\n",
+           N_BARBERS, M_WAITING_CHAIRS, elapsed, session.wait.count);
+    if (session.wait.count > 0) {
+        hist_print("Espera:", &session.wait, 1, " s");
+        hist_print("Corte:", &session.service, 1, " s");
+        hist_print("Tiempo total:", &session.sojourn, 1, " s");
+    }
+    hist_print("Uso de peluqueros:", &utilization, 100, "%");
+    pthread_mutex_unlock(&mutex_stats);
+}
 
-    // 4. Update TUI display lists (protected by ncurses mutex)
-    pthread_mutex_lock(&mutex_ncurses);
-    for(int i=0; i<M_WAITING_CHAIRS; i++) {
-        if(display_waiting[i][0] == '\0') {
-            strcpy(display_waiting[i], info->name);
-            break;
+// --- Command Line ---
+// Parses "1,2,4" into out (at most SWEEP_MAX values, each > 0). Returns the
+// count, or -1.
+int parse_int_list(const char *text, int *out) {
+    int n = 0;
+    const char *p = text;
+    while (n < SWEEP_MAX) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value <= 0 || value > 1000000000L || (*end != ',' && *end != '\0')) {
+            return -1;
         }
+        out[n++] = (int) value;
+        if (*end == '\0') {
+            return n;
+        }
+        p = end + 1;
     }
-    draw_main_window(main_win);
-    pthread_mutex_unlock(&mutex_ncurses);
+    return -1;
+}
 
-    // 7. Wait for an available barber
-    sem_wait(&sem_barbers);
+// Parses "fifo,sjf" into out. Returns the count, or -1 naming the bad policy.
+int parse_policy_list(const char *text, Policy *out) {
+    char copy[256];
+    if (strlen(text) >= sizeof(copy)) {
+        fprintf(stderr, "Error: La lista de --policy es demasiado larga.\n");
+        return -1;
+    }
+    strcpy(copy, text);
+    int n = 0;
+    char *save;
+    for (char *name = strtok_r(copy, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        if (n == SWEEP_MAX || policy_from_name(name, &out[n]) != 0) {
+            fprintf(stderr, "Error: Política desconocida: %s (use 'fifo', 'sjf' o 'priority').\n", name);
+            return -1;
+        }
+        n++;
+    }
+    return n;
+}
 
-    // Client thread is done.
-    free(info);
-    return NULL;
+void print_usage() {
+    fprintf(stderr, "Uso: pelutiu [--waitroom locked|lockfree] <num_peluqueros> <num_sillas_espera>\n");
+    fprintf(stderr, "     pelutiu --headless [--clients N] [--rate R] [--haircut S] [--seed X]\n");
+    fprintf(stderr, "             <num_peluqueros> <num_sillas_espera>\n");
+    fprintf(stderr, "     pelutiu [--headless] --trace ARCHIVO <num_peluqueros> <num_sillas_espera>\n");
+    fprintf(stderr, "     pelutiu [--headless] --arrivals poisson|bursty|diurnal [--burst N]\n");
+    fprintf(stderr, "             [--period S] ... <num_peluqueros> <num_sillas_espera>\n");
+    fprintf(stderr, "     pelutiu --sweep [--policy P,P...] [--format csv|json|text] ...\n");
+    fprintf(stderr, "             <peluqueros,peluqueros...> <sillas,sillas...>\n");
+    fprintf(stderr, "Ejemplo: pelutiu 2 4\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  --headless   Simula sin interfaz, en tiempo virtual, y muestra un resumen.\n");
+    fprintf(stderr, "  --clients N  Clientes a simular (por defecto: 1000000).\n");
+    fprintf(stderr, "  --rate R     Llegadas por segundo, como proceso de Poisson (por defecto:\n");
+    fprintf(stderr, "               las que ocupan el 90%% de los peluqueros).\n");
+    fprintf(stderr, "  --haircut S  Duración media del corte en segundos, exponencial\n");
+    fprintf(stderr, "               (por defecto: 5).\n");
+    fprintf(stderr, "  --seed X     Semilla; con la misma semilla se repite la simulación.\n");
+    fprintf(stderr, "  --arrivals G Generador de llegadas: 'poisson' (por defecto sin interfaz),\n");
+    fprintf(stderr, "               'bursty' (grupos) o 'diurnal' (la tasa sube y baja). Con\n");
+    fprintf(stderr, "               interfaz, los clientes llegan en tiempo real.\n");
+    fprintf(stderr, "  --burst N    Tamaño medio de los grupos de 'bursty' (por defecto: 8).\n");
+    fprintf(stderr, "  --period S   Período en segundos de 'diurnal' (por defecto: 86400).\n");
+    fprintf(stderr, "  --trace F    Lee los clientes de una traza CSV (tiempo,nombre,corte) o\n");
+    fprintf(stderr, "               binaria, en lugar de generarlos.\n");
+    fprintf(stderr, "  --write-trace F  Guarda las llegadas como traza binaria y termina.\n");
+    fprintf(stderr, "  --waitroom T Sala de espera: 'locked' (mutex y semáforo, por defecto) o\n");
+    fprintf(stderr, "               'lockfree' (cola sin bloqueos).\n");
+    fprintf(stderr, "  --policy P   Sin interfaz: a quién atiende un peluquero libre: 'fifo' (el\n");
+    fprintf(stderr, "               primero en llegar, por defecto), 'sjf' (el corte más corto)\n");
+    fprintf(stderr, "               o 'priority' (mayor prioridad primero).\n");
+    fprintf(stderr, "  --outside-limit N  Sin interfaz: si ya hay N afuera, el cliente se va.\n");
+    fprintf(stderr, "  --format F   Salida sin interfaz: 'text' (por defecto), 'csv' o 'json'.\n");
+    fprintf(stderr, "  --max-clients N  Con interfaz: clientes en el local a la vez como mucho\n");
+    fprintf(stderr, "               (por defecto: 1000000). Con el local lleno, la traza espera\n");
+    fprintf(stderr, "               y los clientes escritos se van.\n");
+    fprintf(stderr, "  --sweep      Simula sin interfaz cada combinación de las listas de\n");
+    fprintf(stderr, "               peluqueros, sillas y --policy, en paralelo (salida CSV\n");
+    fprintf(stderr, "               por defecto).\n");
 }
 
+enum {
+    OPT_HEADLESS = 256, OPT_CLIENTS, OPT_RATE, OPT_HAIRCUT, OPT_SEED, OPT_WAITROOM,
+    OPT_ARRIVALS, OPT_BURST, OPT_PERIOD, OPT_TRACE, OPT_WRITE_TRACE,
+    OPT_POLICY, OPT_OUTSIDE_LIMIT, OPT_FORMAT, OPT_SWEEP, OPT_MAX_CLIENTS,
+};
+
+static const struct option long_options[] = {
+    { "headless", no_argument, NULL, OPT_HEADLESS },
+    { "clients", required_argument, NULL, OPT_CLIENTS },
+    { "rate", required_argument, NULL, OPT_RATE },
+    { "haircut", required_argument, NULL, OPT_HAIRCUT },
+    { "seed", required_argument, NULL, OPT_SEED },
+    { "waitroom", required_argument, NULL, OPT_WAITROOM },
+    { "arrivals", required_argument, NULL, OPT_ARRIVALS },
+    { "burst", required_argument, NULL, OPT_BURST },
+    { "period", required_argument, NULL, OPT_PERIOD },
+    { "trace", required_argument, NULL, OPT_TRACE },
+    { "write-trace", required_argument, NULL, OPT_WRITE_TRACE },
+    { "policy", required_argument, NULL, OPT_POLICY },
+    { "outside-limit", required_argument, NULL, OPT_OUTSIDE_LIMIT },
+    { "format", required_argument, NULL, OPT_FORMAT },
+    { "max-clients", required_argument, NULL, OPT_MAX_CLIENTS },
+    { "sweep", no_argument, NULL, OPT_SWEEP },
+    { NULL, 0, NULL, 0 },
+};
+
 // --- Main Function ---
 int main(int argc, char *argv[]) {
     // 1. Validate and get arguments
-    if (argc != 3) {
-        fprintf(stderr, "Uso: pelutiu_v2 <num_peluqueros> <num_sillas_espera>\n");
-        fprintf(stderr, "Ejemplo: pelutiu_v2 2 4\n");
+    int headless = 0;
+    WaitroomKind waitroom_kind = WAITROOM_LOCKED;
+    long n_clients = 1000000;
+    double arrival_rate = 0;  // 0: the rate that keeps 90% of the barbers busy
+    double mean_haircut = 5.0;
+    unsigned long long seed = 1;
+    ArrivalKind arrivals = ARRIVALS_POISSON;
+    int generate = 0;         // --arrivals given
+    double burst = 8;
+    double period = 86400;
+    const char* trace_path = NULL;
+    const char* write_trace_path = NULL;
+    const char* policy_list = "fifo";
+    long outside_limit = 0;
+    OutputFormat format = OUTPUT_TEXT;
+    int format_given = 0;
+    int sweep = 0;
+    int max_clients_given = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (opt) {
+        case OPT_HEADLESS:
+            headless = 1;
+            break;
+        case OPT_CLIENTS:
+            n_clients = atol(optarg);
+            break;
+        case OPT_RATE:
+            arrival_rate = atof(optarg);
+            break;
+        case OPT_HAIRCUT:
+            mean_haircut = atof(optarg);
+            break;
+        case OPT_SEED:
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_ARRIVALS:
+            if (workload_kind_from_name(optarg, &arrivals) != 0) {
+                fprintf(stderr, "Error: Generador desconocido: %s (use 'poisson', 'bursty' o 'diurnal').\n", optarg);
+                return 1;
+            }
+            generate = 1;
+            break;
+        case OPT_BURST:
+            burst = atof(optarg);
+            break;
+        case OPT_PERIOD:
+            period = atof(optarg);
+            break;
+        case OPT_TRACE:
+            trace_path = optarg;
+            break;
+        case OPT_WRITE_TRACE:
+            write_trace_path = optarg;
+            break;
+        case OPT_POLICY:
+            policy_list = optarg;
+            break;
+        case OPT_OUTSIDE_LIMIT:
+            outside_limit = atol(optarg);
+            break;
+        case OPT_FORMAT:
+            if (output_format_from_name(optarg, &format) != 0) {
+                fprintf(stderr, "Error: Formato desconocido: %s (use 'text', 'csv' o 'json').\n", optarg);
+                return 1;
+            }
+            format_given = 1;
+            break;
+        case OPT_SWEEP:
+            sweep = 1;
+            break;
+        case OPT_MAX_CLIENTS:
+            client_cap = atol(optarg);
+            max_clients_given = 1;
+            break;
+        case OPT_WAITROOM:
+            if (waitroom_kind_from_name(optarg, &waitroom_kind) != 0) {
+                fprintf(stderr, "Error: Sala de espera desconocida: %s (use 'locked' o 'lockfree').\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            print_usage();
+            return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        print_usage();
         return 1;
     }
-    N_BARBERS = atoi(argv[1]);
-    M_WAITING_CHAIRS = atoi(argv[2]);
-
-    if (N_BARBERS <= 0 || M_WAITING_CHAIRS <= 0) {
-        fprintf(stderr, "Error: El número de peluqueros y sillas de espera debe ser mayor que 0.\n");
+    // A sweep takes lists; everything else one value each
+    int barber_list[SWEEP_MAX], chair_list[SWEEP_MAX];
+    Policy policies[SWEEP_MAX];
+    int n_barber_list = parse_int_list(argv[optind], barber_list);
+    int n_chair_list = parse_int_list(argv[optind + 1], chair_list);
+    int n_policies = parse_policy_list(policy_list, policies);
+    if (n_policies < 0) {
         return 1;
     }
-    if (M_WAITING_CHAIRS > 20) { // Limit by array size
-        fprintf(stderr, "Error: El número máximo de sillas de espera es 20.\n");
+    if (n_barber_list < 0 || n_chair_list < 0 ||
+        (!sweep && (n_barber_list != 1 || n_chair_list != 1 || n_policies != 1))) {
+        fprintf(stderr, "Error: El número de peluqueros y sillas de espera debe ser mayor que 0%s.\n",
+                sweep ? "" : " (las listas separadas por comas son para --sweep)");
         return 1;
     }
-    if (N_BARBERS > 20) { // Limit by array size
-        fprintf(stderr, "Error: El número máximo de peluqueros es 20.\n");
+    if (outside_limit < 0) {
+        fprintf(stderr, "Error: --outside-limit no puede ser negativo.\n");
         return 1;
     }
-    
+    if (!sweep && !headless && (policies[0] != POLICY_FIFO || outside_limit > 0 || format_given)) {
+        fprintf(stderr, "Error: --policy, --outside-limit y --format son para --headless o --sweep.\n");
+        return 1;
+    }
+    if (client_cap <= 0 || (max_clients_given && (headless || sweep))) {
+        fprintf(stderr, "Error: --max-clients debe ser mayor que 0 y es para el modo con interfaz.\n");
+        return 1;
+    }
+    int rate_given = arrival_rate > 0;
+    N_BARBERS = barber_list[0];
+    M_WAITING_CHAIRS = chair_list[0];
+
+    // Workload: a trace, a generator, or (interactive mode) only typed clients.
+    // Static, like render_view: the feeder thread reads it until main joins it.
+    static Workload workload;
+    if (trace_path != NULL) {
+        if (workload_open_trace(&workload, trace_path) != 0) {
+            fprintf(stderr, "Error: No se puede leer la traza %s: %s\n", trace_path, strerror(errno));
+            return 1;
+        }
+    } else if (generate || headless || sweep || write_trace_path != NULL) {
+        if (n_clients <= 0 || mean_haircut <= 0 || arrival_rate < 0 || burst < 1 || period <= 0) {
+            fprintf(stderr, "Error: --clients, --haircut y --period deben ser mayores que 0, --burst al menos 1, y --rate no puede ser negativo.\n");
+            return 1;
+        }
+        if (arrival_rate == 0) {
+            arrival_rate = 0.9 * N_BARBERS / mean_haircut;
+        }
+        workload_generator(&workload, arrivals, n_clients, arrival_rate, mean_haircut, seed);
+        workload_shape(&workload, burst, period);
+    }
+
+    if (write_trace_path != NULL) {
+        long written = workload_write_trace(&workload, write_trace_path);
+        workload_close(&workload);
+        if (written == -1) {
+            fprintf(stderr, "Error: No se puede escribir %s: %s\n", write_trace_path, strerror(errno));
+            return 1;
+        }
+        if (written == -2) {
+            fprintf(stderr, "Error: Registro %ld de la traza mal formado.\n", workload.record);
+            return 1;
+        }
+        printf("%ld clientes guardados en %s\n", written, write_trace_path);
+        return 0;
+    }
+
+    // Sweep: every combination on the same arrivals, one thread per core
+    if (sweep) {
+        SweepConfig sweep_cfg = {
+            .barbers = barber_list, .n_barbers = n_barber_list,
+            .chairs = chair_list, .n_chairs = n_chair_list,
+            .policies = policies, .n_policies = n_policies,
+            .outside_limit = outside_limit,
+            .auto_rate = !rate_given,
+            .arrivals = &workload,
+        };
+        long bad_record = 0;
+        int ret = sweep_run(&sweep_cfg, format_given ? format : OUTPUT_CSV, &bad_record);
+        workload_close(&workload);
+        if (ret == -2) {
+            fprintf(stderr, "Error: Registro %ld de la traza mal formado o fuera de orden.\n", bad_record);
+            return 1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Error: Memoria insuficiente para la simulación.\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Headless: run the discrete-event engine and print the summary. It
+    // keeps no fixed-size arrays, so the limits below don't apply.
+    if (headless) {
+        SimConfig sim = {
+            .n_barbers = N_BARBERS, .n_chairs = M_WAITING_CHAIRS, .policy = policies[0],
+            .outside_limit = outside_limit, .arrivals = &workload,
+        };
+        static SimStats stats; // Histograms: too big for a comfortable stack frame
+        int ret = sim_run(&sim, &stats);
+        workload_close(&workload);
+        if (ret == -2) {
+            fprintf(stderr, "Error: Registro %ld de la traza mal formado o fuera de orden.\n", workload.record);
+            return 1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Error: Memoria insuficiente para la simulación.\n");
+            return 1;
+        }
+        SimSummary summary;
+        sim_summarize(&stats, &summary);
+        if (format == OUTPUT_CSV) {
+            sim_print_csv_header(stdout);
+            sim_print_csv(stdout, &sim, &summary);
+        } else if (format == OUTPUT_JSON) {
+            sim_print_json(stdout, &sim, &summary);
+            printf("\n");
+        } else {
+            sim_print(&sim, &summary);
+        }
+        return 0;
+    }
+
+    // Shop structures, sized for this run: no limit on barbers or chairs
+    static ShopView render_view; // The render thread's copy
+    if (waitroom_init(&waiting_room, waitroom_kind, M_WAITING_CHAIRS) != 0 ||
+        posix_memalign((void**) &barbers, 64, N_BARBERS * sizeof(Barber)) != 0 ||
+        (free_slots = malloc(M_WAITING_CHAIRS * sizeof(int))) == NULL ||
+        view_alloc(&shop_view) != 0 || view_alloc(&render_view) != 0) {
+        fprintf(stderr, "Error: Memoria insuficiente para la peluquería.\n");
+        return 1;
+    }
+    for (int i = 0; i < M_WAITING_CHAIRS; i++) {
+        free_slots[i] = i;
+    }
+    n_free_slots = M_WAITING_CHAIRS;
+
     // 2. Initialize ncurses
     initscr();             
     cbreak();              
@@ -270,48 +1094,89 @@ int main(int argc, char *argv[]) {
     // Create windows
     main_win = newwin(LINES - PROMPT_HEIGHT, COLS, 0, 0);
     input_win = newwin(PROMPT_HEIGHT, COLS, LINES - PROMPT_HEIGHT, 0);
+    keypad(input_win, TRUE); // The render thread reads the prompt's keys
     scrollok(main_win, TRUE); // Not strictly needed but good practice
     
     // 3. Initialize synchronization primitives
-    sem_init(&sem_customers, 0, 0);             // No customers initially
-    sem_init(&sem_barbers, 0, N_BARBERS);       // All barbers are free initially
-    sem_init(&sem_waiting_chairs, 0, M_WAITING_CHAIRS); // All waiting chairs are free
+    free_chairs = M_WAITING_CHAIRS;             // All waiting chairs are free
     pthread_mutex_init(&mutex_access_chairs, NULL);
-    pthread_mutex_init(&mutex_ncurses, NULL);
+    pthread_mutex_init(&mutex_view, NULL);
+    pthread_mutex_init(&mutex_work, NULL);
+    pthread_cond_init(&cond_work, NULL);
+    pthread_mutex_init(&mutex_pool, NULL);
+    pthread_cond_init(&cond_pool, NULL);
+    pthread_mutex_init(&mutex_stats, NULL);
+    pthread_mutex_init(&mutex_feeder, NULL);
+    pthread_condattr_t feeder_attr; // Deadlines come from CLOCK_MONOTONIC, like the trace's start
+    pthread_condattr_init(&feeder_attr);
+    pthread_condattr_setclock(&feeder_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_feeder, &feeder_attr);
+    pthread_condattr_destroy(&feeder_attr);
+    pthread_mutex_init(&mutex_input, NULL);
+    pthread_cond_init(&cond_input, NULL);
+    session.start = now_seconds(); // The histograms start zeroed (static)
     
-    // 4. Initialize display lists
-    for(int i=0; i<M_WAITING_CHAIRS; i++) display_waiting[i][0] = '\0';
-    for(int i=0; i<N_BARBERS; i++) display_cutting[i][0] = '\0';
-    for(int i=0; i<100; i++) display_afuera[i][0] = '\0';
+    // 4. Display lists start empty (allocated zeroed above)
 
     // 5. Create barber threads
-    pthread_t barber_tids[N_BARBERS];
-    int barber_ids[N_BARBERS];
+    pthread_attr_t barber_attr;
+    pthread_attr_init(&barber_attr);
+    pthread_attr_setstacksize(&barber_attr, BARBER_STACK);
     for (int i = 0; i < N_BARBERS; i++) {
-        barber_ids[i] = i; // Assign a unique ID to each barber
-        pthread_create(&barber_tids[i], NULL, barber_thread, &barber_ids[i]);
+        barbers[i].id = i; // Assign a unique ID to each barber
+        barbers[i].served = 0;
+        barbers[i].busy = 0;
+        if (pthread_create(&barbers[i].tid, &barber_attr, barber_thread, &barbers[i]) != 0) {
+            endwin();
+            fprintf(stderr, "Error: No se pudo crear el peluquero %d de %d.\n", i + 1, N_BARBERS);
+            return 1;
+        }
+    }
+    pthread_attr_destroy(&barber_attr);
+
+    // 5b. Create the worker threads that move clients through their states
+    //     (without them, clients would be queued and never move)
+    pthread_t worker_tids[WORKER_THREADS];
+    for (int i = 0; i < WORKER_THREADS; i++) {
+        if (pthread_create(&worker_tids[i], NULL, worker_thread, NULL) != 0) {
+            endwin();
+            fprintf(stderr, "Error: No se pudo crear el hilo trabajador %d de %d.\n", i + 1, WORKER_THREADS);
+            return 1;
+        }
     }
     
-    // 6. Main loop for TUI and input
-    char input_buffer[100];
-    
-    // Initial draw
-    pthread_mutex_lock(&mutex_ncurses);
-    draw_main_window(main_win);
-    pthread_mutex_unlock(&mutex_ncurses);
+    // 5c. Create the render thread, which draws the first frame
+    pthread_t render_tid;
+    if (pthread_create(&render_tid, NULL, render_thread, &render_view) != 0) {
+        endwin();
+        fprintf(stderr, "Error: No se pudo crear el hilo de dibujo.\n");
+        return 1;
+    }
+
+    // 5d. Replay the workload, if any, next to the typed clients
+    pthread_t feeder_tid;
+    int feeding = trace_path != NULL || generate;
+    if (feeding && pthread_create(&feeder_tid, NULL, feeder_thread, &workload) != 0) {
+        __atomic_store_n(&render_stop, 1, __ATOMIC_RELAXED);
+        pthread_join(render_tid, NULL);
+        endwin();
+        fprintf(stderr, "Error: No se pudo crear el hilo que reproduce las llegadas.\n");
+        return 1;
+    }
+
+    // 6. Main loop for input. The render thread reads and echoes the keys;
+    //    main never touches the terminal until the render thread is done.
+    char input_buffer[INPUT_LEN];
 
     while (1) {
-        // Prepare the input window
-        werase(input_win);
-        box(input_win, 0, 0);
-        mvwprintw(input_win, 1, 2, "Ingress Cliente: ");
-        wmove(input_win, 1, 19);
-        wrefresh(input_win);
-
-        // b. Capture user input (Name Time)
-        echo(); // Temporarily enable echo for input
-        wgetstr(input_win, input_buffer); // Blocks until ENTER
-        noecho(); // Disable echo
+        // b. Wait for a finished line (Name Time)
+        pthread_mutex_lock(&mutex_input);
+        while (!input_ready) {
+            pthread_cond_wait(&cond_input, &mutex_input);
+        }
+        strcpy(input_buffer, input_line);
+        input_ready = 0;
+        pthread_mutex_unlock(&mutex_input);
 
         char name[MAX_NAME_LEN];
         int time;
@@ -321,36 +1186,65 @@ int main(int argc, char *argv[]) {
             break; // Exit main loop
         }
 
-        if (sscanf(input_buffer, "%s %d", name, &time) == 2) {
-            ClientData* info = (ClientData*)malloc(sizeof(ClientData));
+        const char* error = NULL;
+        ClientData* info = NULL;
+        if (sscanf(input_buffer, "%29s %d", name, &time) != 2) {
+            error = "Entrada inválida. Use: <nombre> <tiempo> o 'exit'";
+        } else if ((info = client_alloc()) == NULL) {
+            error = errno == EAGAIN ? "Local lleno: el cliente se fue (--max-clients)"
+                                    : "Memoria insuficiente: el cliente no pudo entrar";
+        }
+        if (error == NULL) {
             strncpy(info->name, name, MAX_NAME_LEN - 1);
             info->name[MAX_NAME_LEN - 1] = '\0'; // Ensure null termination
             info->haircut_time = time;
-            
-            // d. Create client thread
-            pthread_t client_tid;
-            pthread_create(&client_tid, NULL, client_thread, (void*)info);
-            pthread_detach(client_tid); // Don't join client threads
-        } else { // Handle invalid input
-            mvwprintw(input_win, 2, 2, "Entrada inválida. Use: <nombre> <tiempo> o 'exit'");
-            wrefresh(input_win);
-            sleep(1);
+            info->state = CLIENT_ARRIVING;
+
+            // d. Hand the arrival to the worker threads
+            submit_step(info);
+        } else { // Handle invalid input or a full memory: the render thread shows it
+            pthread_mutex_lock(&mutex_input);
+            input_message = error;
+            pthread_mutex_unlock(&mutex_input);
         }
     }
 
-    // 7. Cleanup (will be reached now)
+    // 7. Cleanup (will be reached now). Stop the render thread first: it
+    //    must not draw after endwin()
+    __atomic_store_n(&render_stop, 1, __ATOMIC_RELAXED);
+    pthread_join(render_tid, NULL);
     delwin(main_win);
     delwin(input_win);
     endwin();
-    sem_destroy(&sem_customers);
-    sem_destroy(&sem_barbers);
-    sem_destroy(&sem_waiting_chairs);
-    pthread_mutex_destroy(&mutex_access_chairs);
-    pthread_mutex_destroy(&mutex_ncurses);
-    
-    // For detached threads, no need to join.
-    // If barbers were joinable, we'd need a way to signal them to exit.
-    // For a daemon-like program, they usually run indefinitely.
+
+    // 8. No more arrivals: stop the feeder, then let the workers run what is
+    //    queued and end
+    if (feeding) {
+        pthread_mutex_lock(&mutex_feeder);
+        __atomic_store_n(&feeder_stop, 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&cond_feeder);
+        pthread_mutex_unlock(&mutex_feeder);
+        pthread_mutex_lock(&mutex_pool); // It may be waiting for a record
+        pthread_cond_broadcast(&cond_pool);
+        pthread_mutex_unlock(&mutex_pool);
+        pthread_join(feeder_tid, NULL);
+    }
+    pthread_mutex_lock(&mutex_work);
+    work_stop = 1;
+    pthread_cond_broadcast(&cond_work);
+    pthread_mutex_unlock(&mutex_work);
+    for (int i = 0; i < WORKER_THREADS; i++) {
+        pthread_join(worker_tids[i], NULL);
+    }
+
+    if (feeder_error != 0) {
+        fprintf(stderr, "Error: Registro %ld de la traza mal formado o fuera de orden.\n", feeder_error);
+    }
+    print_session();
+
+    // Barbers are never joined: they may be asleep in the waiting room or in
+    // the middle of a long haircut. They still use the waiting room and the
+    // mutexes, so nothing they touch is destroyed; the process ends here.
 
     return 0;
 }
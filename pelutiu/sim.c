@@ -0,0 +1,424 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *policy_names[] = { "fifo", "sjf", "priority" };
+static const char *format_names[] = { "text", "csv", "json" };
+
+static int index_of(const char *name, const char **names, int n) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int policy_from_name(const char *name, Policy *policy) {
+    int i = index_of(name, policy_names, sizeof(policy_names) / sizeof(policy_names[0]));
+    if (i < 0) {
+        return -1;
+    }
+    *policy = (Policy) i;
+    return 0;
+}
+
+const char *policy_name(Policy policy) {
+    return policy_names[policy];
+}
+
+int output_format_from_name(const char *name, OutputFormat *format) {
+    int i = index_of(name, format_names, sizeof(format_names) / sizeof(format_names[0]));
+    if (i < 0) {
+        return -1;
+    }
+    *format = (OutputFormat) i;
+    return 0;
+}
+
+// --- Clients and queues ---
+typedef struct {
+    double arrival;  // Virtual time the client walked in
+    double haircut;  // Service time
+    int priority;
+    long seq;        // Arrival order, for FIFO and to break ties
+} Client;
+
+// FIFO of clients on a ring that doubles when full (the outside queue has no
+// bound)
+typedef struct {
+    Client *items;
+    long head;
+    long len;
+    long cap;
+} ClientQueue;
+
+static int queue_push(ClientQueue *q, Client c) {
+    if (q->len == q->cap) {
+        long cap = q->cap ? q->cap * 2 : 64;
+        Client *items = malloc(cap * sizeof(Client));
+        if (items == NULL) {
+            return -1;
+        }
+        // Unroll the ring so head is at 0 again
+        for (long i = 0; i < q->len; i++) {
+            items[i] = q->items[(q->head + i) % q->cap];
+        }
+        free(q->items);
+        q->items = items;
+        q->head = 0;
+        q->cap = cap;
+    }
+    q->items[(q->head + q->len) % q->cap] = c;
+    q->len++;
+    return 0;
+}
+
+static Client queue_pop(ClientQueue *q) {
+    Client c = q->items[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    return c;
+}
+
+// The chairs: a binary heap ordered by the policy, so a free barber takes the
+// next client in O(log n_chairs). Its capacity is fixed at n_chairs.
+typedef struct {
+    Client *items;
+    int len;
+    Policy policy;
+} ChairHeap;
+
+static int client_before(const ChairHeap *h, const Client *a, const Client *b) {
+    switch (h->policy) {
+    case POLICY_SJF:
+        if (a->haircut != b->haircut) {
+            return a->haircut < b->haircut;
+        }
+        break;
+    case POLICY_PRIORITY:
+        if (a->priority != b->priority) {
+            return a->priority > b->priority;
+        }
+        break;
+    default:
+        break;
+    }
+    return a->seq < b->seq;
+}
+
+static void chairs_push(ChairHeap *h, Client c) {
+    int i = h->len++;
+    while (i > 0 && client_before(h, &c, &h->items[(i - 1) / 2])) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = c;
+}
+
+static Client chairs_pop(ChairHeap *h) {
+    Client top = h->items[0];
+    Client last = h->items[--h->len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= h->len) {
+            break;
+        }
+        if (child + 1 < h->len && client_before(h, &h->items[child + 1], &h->items[child])) {
+            child++;
+        }
+        if (!client_before(h, &h->items[child], &last)) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = last;
+    return top;
+}
+
+// --- Event queue ---
+// Binary min-heap on virtual time. Events at the same time come out in the
+// order they were scheduled (seq), so a run only depends on the seed.
+typedef enum {
+    EV_ARRIVAL,
+    EV_HAIRCUT_DONE,
+} EventType;
+
+typedef struct {
+    double time;
+    unsigned long seq;
+    EventType type;
+    int barber;
+} Event;
+
+typedef struct {
+    Event *items;
+    int len;
+    int cap;
+    unsigned long next_seq;
+} EventHeap;
+
+static int event_before(const Event *a, const Event *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void heap_push(EventHeap *h, double time, EventType type, int barber) {
+    // Capacity is fixed at start: at most one pending arrival plus one
+    // haircut per barber
+    Event ev = { time, h->next_seq++, type, barber };
+    int i = h->len++;
+    while (i > 0 && event_before(&ev, &h->items[(i - 1) / 2])) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = ev;
+}
+
+static Event heap_pop(EventHeap *h) {
+    Event top = h->items[0];
+    Event last = h->items[--h->len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= h->len) {
+            break;
+        }
+        if (child + 1 < h->len && event_before(&h->items[child + 1], &h->items[child])) {
+            child++;
+        }
+        if (!event_before(&h->items[child], &last)) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = last;
+    return top;
+}
+
+// --- Shop state ---
+typedef struct {
+    const SimConfig *cfg;
+    SimStats *stats;
+    EventHeap events;
+    Arrival next;       // The arrival scheduled in the heap
+    ChairHeap chairs;
+    ClientQueue outside;
+    int *idle_barbers;  // Stack of free barber ids
+    int n_idle;
+    double *busy;       // Per barber, time spent cutting
+    long next_seq;
+    double now;
+} Shop;
+
+// A free barber takes the next client from the chairs, and the first client
+// outside (if any) sits down in the chair that was freed. Every time of the
+// client is known here, so this is where the client is measured.
+static void start_haircut(Shop *s) {
+    Client c = chairs_pop(&s->chairs);
+    int barber = s->idle_barbers[--s->n_idle];
+
+    double wait = s->now - c.arrival;
+    hist_add(&s->stats->wait, wait);
+    hist_add(&s->stats->service, c.haircut);
+    hist_add(&s->stats->sojourn, wait + c.haircut);
+    s->stats->busy_time += c.haircut;
+    s->busy[barber] += c.haircut;
+    heap_push(&s->events, s->now + c.haircut, EV_HAIRCUT_DONE, barber);
+
+    if (s->outside.len > 0) {
+        chairs_push(&s->chairs, queue_pop(&s->outside));
+    }
+}
+
+static void dispatch(Shop *s) {
+    while (s->n_idle > 0 && s->chairs.len > 0) {
+        start_haircut(s);
+    }
+}
+
+static int client_arrives(Shop *s, const Arrival *a) {
+    Client c = { s->now, a->haircut, a->priority, s->next_seq++ };
+    s->stats->arrived++;
+    if (s->chairs.len < s->cfg->n_chairs) {
+        chairs_push(&s->chairs, c);
+    } else if (s->cfg->outside_limit > 0 && s->outside.len >= s->cfg->outside_limit) {
+        // Too many people outside: the client doesn't stay
+        s->stats->balked++;
+        return 0;
+    } else {
+        // Every chair taken: wait outside
+        if (queue_push(&s->outside, c) != 0) {
+            return -1;
+        }
+        s->stats->waited_outside++;
+        if (s->outside.len > s->stats->max_outside) {
+            s->stats->max_outside = s->outside.len;
+        }
+    }
+    dispatch(s);
+    return 0;
+}
+
+static double elapsed(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int sim_run(const SimConfig *cfg, SimStats *stats) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Shop s = { .cfg = cfg, .stats = stats };
+    memset(stats, 0, sizeof(*stats));
+
+    s.events.cap = cfg->n_barbers + 1;
+    s.events.items = malloc(s.events.cap * sizeof(Event));
+    s.idle_barbers = malloc(cfg->n_barbers * sizeof(int));
+    s.busy = calloc(cfg->n_barbers, sizeof(double));
+    s.chairs.items = malloc(cfg->n_chairs * sizeof(Client));
+    s.chairs.policy = cfg->policy;
+    int ret = -1;
+    if (s.events.items == NULL || s.idle_barbers == NULL || s.busy == NULL || s.chairs.items == NULL) {
+        goto out;
+    }
+    for (int i = 0; i < cfg->n_barbers; i++) {
+        s.idle_barbers[i] = cfg->n_barbers - 1 - i; // Barber 0 on top
+    }
+    s.n_idle = cfg->n_barbers;
+
+    // Arrivals are scheduled one at a time: each one schedules the next, so
+    // the heap never holds more than n_barbers + 1 events. Clients of a batch
+    // share the time and come out of the heap in order.
+    int more = workload_next(cfg->arrivals, &s.next);
+    if (more == 1) {
+        heap_push(&s.events, s.next.time, EV_ARRIVAL, -1);
+    }
+    while (more >= 0 && s.events.len > 0) {
+        Event ev = heap_pop(&s.events);
+        s.now = ev.time;
+        stats->events++;
+
+        if (ev.type == EV_ARRIVAL) {
+            Arrival a = s.next;
+            stats->last_arrival = s.now;
+            more = workload_next(cfg->arrivals, &s.next);
+            if (more == 1) {
+                heap_push(&s.events, s.next.time, EV_ARRIVAL, -1);
+            }
+            if (client_arrives(&s, &a) != 0) {
+                goto out;
+            }
+        } else {
+            // Haircut done: the barber is free for the next chair
+            stats->served++;
+            s.idle_barbers[s.n_idle++] = ev.barber;
+            dispatch(&s);
+        }
+    }
+    stats->sim_time = s.now;
+    for (int i = 0; i < cfg->n_barbers; i++) {
+        hist_add(&stats->utilization, s.now > 0 ? s.busy[i] / s.now : 0.0);
+    }
+    ret = more < 0 ? -2 : 0;
+
+out:
+    stats->wall_time = elapsed(&start);
+    free(s.events.items);
+    free(s.idle_barbers);
+    free(s.busy);
+    free(s.chairs.items);
+    free(s.outside.items);
+    return ret;
+}
+
+// --- Output ---
+void sim_summarize(const SimStats *stats, SimSummary *out) {
+    out->arrived = stats->arrived;
+    out->served = stats->served;
+    out->balked = stats->balked;
+    out->last_arrival = stats->last_arrival;
+    out->waited_outside = stats->waited_outside;
+    out->max_outside = stats->max_outside;
+    out->events = stats->events;
+    out->sim_time = stats->sim_time;
+    out->busy_time = stats->busy_time;
+    out->wall_time = stats->wall_time;
+    hist_summarize(&stats->wait, &out->wait);
+    hist_summarize(&stats->service, &out->service);
+    hist_summarize(&stats->sojourn, &out->sojourn);
+    hist_summarize(&stats->utilization, &out->utilization);
+}
+
+void sim_print(const SimConfig *cfg, const SimSummary *sum) {
+    long arrived = sum->arrived;
+    printf("Simulación: %d peluqueros, %d sillas, %ld clientes, política %s\n",
+           cfg->n_barbers, cfg->n_chairs, arrived, policy_name(cfg->policy));
+    // Measured, so they hold for traces and every generator alike
+    printf("  Llegadas por segundo:  %.3f\n",
+           sum->last_arrival > 0 ? arrived / sum->last_arrival : 0.0);
+    printf("  Corte medio:           %.3f s\n", sum->service.mean);
+    printf("  Tiempo simulado:       %.1f s\n", sum->sim_time);
+    printf("  Atendidos:             %ld\n", sum->served);
+    printf("  Se fueron sin esperar: %ld (%.1f%%)\n", sum->balked,
+           arrived ? 100.0 * sum->balked / arrived : 0.0);
+    // Out of everyone who came: a client can wait outside and still not be
+    // served by the end of the run
+    printf("  Esperaron afuera:      %ld (%.1f%%)\n", sum->waited_outside,
+           arrived ? 100.0 * sum->waited_outside / arrived : 0.0);
+    printf("  Máximo afuera:         %ld\n", sum->max_outside);
+    hist_print_summary("Espera:", &sum->wait, 1, " s");
+    hist_print_summary("Corte:", &sum->service, 1, " s");
+    hist_print_summary("Tiempo total:", &sum->sojourn, 1, " s");
+    printf("  Ocupación peluqueros:  %.1f%% (mínima %.1f%%, máxima %.1f%%)\n",
+           sum->sim_time > 0 ? 100.0 * sum->busy_time / (sum->sim_time * cfg->n_barbers) : 0.0,
+           100.0 * sum->utilization.min, 100.0 * sum->utilization.max);
+    printf("  Eventos:               %ld en %.3f s (%.2f millones/s)\n", sum->events,
+           sum->wall_time, sum->wall_time > 0 ? sum->events / sum->wall_time / 1e6 : 0.0);
+}
+
+void sim_print_csv_header(FILE *out) {
+    fprintf(out, "barbers,chairs,policy,clients,served,balked,waited_outside,max_outside,"
+                 "utilization,wait_mean,wait_p50,wait_p90,wait_p99,wait_max,"
+                 "service_mean,sojourn_mean,sojourn_p50,sojourn_p90,sojourn_p99,sojourn_max,"
+                 "sim_time,wall_time\n");
+}
+
+void sim_print_csv(FILE *out, const SimConfig *cfg, const SimSummary *sum) {
+    const HistSummary *w = &sum->wait, *t = &sum->sojourn;
+    fprintf(out, "%d,%d,%s,%ld,%ld,%ld,%ld,%ld,%.4f,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.3f\n",
+            cfg->n_barbers, cfg->n_chairs, policy_name(cfg->policy),
+            sum->arrived, sum->served, sum->balked,
+            sum->waited_outside, sum->max_outside, sum->utilization.mean,
+            w->mean, w->p50, w->p90, w->p99, w->max, sum->service.mean,
+            t->mean, t->p50, t->p90, t->p99, t->max,
+            sum->sim_time, sum->wall_time);
+}
+
+static void json_hist(FILE *out, const char *name, const HistSummary *h) {
+    fprintf(out, "\"%s\": {\"mean\": %.6g, \"p50\": %.6g, \"p90\": %.6g, \"p99\": %.6g, \"min\": %.6g, \"max\": %.6g}",
+            name, h->mean, h->p50, h->p90, h->p99, h->min, h->max);
+}
+
+void sim_print_json(FILE *out, const SimConfig *cfg, const SimSummary *sum) {
+    fprintf(out, "{\"barbers\": %d, \"chairs\": %d, \"policy\": \"%s\", \"clients\": %ld, "
+                 "\"served\": %ld, \"balked\": %ld, \"waited_outside\": %ld, \"max_outside\": %ld, ",
+            cfg->n_barbers, cfg->n_chairs, policy_name(cfg->policy),
+            sum->arrived, sum->served, sum->balked,
+            sum->waited_outside, sum->max_outside);
+    json_hist(out, "wait", &sum->wait);
+    fprintf(out, ", ");
+    json_hist(out, "service", &sum->service);
+    fprintf(out, ", ");
+    json_hist(out, "sojourn", &sum->sojourn);
+    fprintf(out, ", ");
+    json_hist(out, "utilization", &sum->utilization);
+    fprintf(out, ", \"sim_time\": %.6g, \"wall_time\": %.3f}", sum->sim_time, sum->wall_time);
+}
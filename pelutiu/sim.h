@@ -0,0 +1,107 @@
+#ifndef SIM_H
+#define SIM_H
+
+// --- Headless discrete-event simulation ---
+// Same shop model as the interactive mode: N barbers, M waiting chairs and an
+// unbounded queue outside for clients who find every chair taken. A client
+// who gets a chair waits there until a barber is free; when a barber takes
+// the client from the chair, the first client outside sits down.
+// Time is virtual: the engine jumps from one event to the next (arrivals and
+// end of haircuts, kept in a min-heap by time), so millions of clients take
+// seconds of CPU instead of hours of sleep().
+// Clients and their haircut times come from a workload (a generator or a
+// trace, see workload.h), so the same seed or trace gives the same run.
+//
+// A free barber picks the next client among those in the chairs by policy:
+//  - POLICY_FIFO:     the one who arrived first (what the TUI does).
+//  - POLICY_SJF:      the shortest haircut first (shortest job first).
+//  - POLICY_PRIORITY: the highest priority first (VIPs, see workload.h).
+// Ties go to whoever arrived first. The queue outside is always FIFO: those
+// clients are not in the shop yet. With outside_limit set, a client who finds
+// that many people outside leaves without waiting (balks).
+
+#include <stdio.h>
+
+#include "stats.h"
+#include "workload.h"
+
+typedef enum {
+    POLICY_FIFO,
+    POLICY_SJF,
+    POLICY_PRIORITY,
+} Policy;
+
+typedef struct {
+    int n_barbers;
+    int n_chairs;
+    Policy policy;
+    long outside_limit;      // 0: no limit, nobody balks
+    Workload *arrivals;
+} SimConfig;
+
+typedef struct {
+    long arrived;            // Every client who showed up, served or not
+    long served;
+    long balked;             // Clients who left because the outside queue was full
+    double last_arrival;     // Virtual time of the last arrival
+    long waited_outside;     // Clients who found every chair taken
+    long max_outside;        // Longest the outside queue got
+    long events;
+    double sim_time;         // Virtual seconds until the last client left
+    double busy_time;        // Sum over barbers of time spent cutting
+    double wall_time;        // Real seconds the run took
+    Histogram wait;          // Arrival -> start of haircut, per client
+    Histogram service;       // Haircut, per client
+    Histogram sojourn;       // Arrival -> leaving, per client
+    Histogram utilization;   // Fraction of sim_time spent cutting, per barber
+} SimStats;
+
+// The part of SimStats the output shows: a few hundred bytes instead of the
+// histograms, for sweeps that keep thousands of runs until they print
+typedef struct {
+    long arrived;
+    long served;
+    long balked;
+    double last_arrival;
+    long waited_outside;
+    long max_outside;
+    long events;
+    double sim_time;
+    double busy_time;
+    double wall_time;
+    HistSummary wait;
+    HistSummary service;
+    HistSummary sojourn;
+    HistSummary utilization;
+} SimSummary;
+
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+} OutputFormat;
+
+// "fifo" / "sjf" / "priority"; returns -1 for an unknown name
+int policy_from_name(const char *name, Policy *policy);
+const char *policy_name(Policy policy);
+
+// "text" / "csv" / "json"; returns -1 for an unknown name
+int output_format_from_name(const char *name, OutputFormat *format);
+
+// Runs the simulation to completion. Returns 0, -1 if out of memory, or -2 if
+// the workload has a malformed record (cfg->arrivals->record).
+// SimStats holds the histograms (about 25 KB): keep it off small stacks.
+int sim_run(const SimConfig *cfg, SimStats *stats);
+
+void sim_summarize(const SimStats *stats, SimSummary *out);
+
+// Prints the summary of a run (UI strings in Spanish, like the TUI)
+void sim_print(const SimConfig *cfg, const SimSummary *sum);
+
+// One run as a CSV row or a JSON object (no newline after it), for scripts.
+// The CSV columns are the same for every run, after sim_print_csv_header().
+void sim_print_csv_header(FILE *out);
+void sim_print_csv(FILE *out, const SimConfig *cfg, const SimSummary *sum);
+void sim_print_json(FILE *out, const SimConfig *cfg, const SimSummary *sum);
+
+#endif
@@ -0,0 +1,96 @@
+#include "stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+void hist_init(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+// Bucket of a value > 0: frexp gives value = m * 2^e with m in [0.5, 1), and
+// m picks the sub-bucket linearly
+static int bucket_of(double value) {
+    int e;
+    double m = frexp(value, &e);
+    if (e <= HIST_MIN_EXP) {
+        return 0;
+    }
+    if (e > HIST_MAX_EXP) {
+        return HIST_BUCKETS - 1;
+    }
+    int sub = (int) ((m - 0.5) * 2 * HIST_SUB_BUCKETS);
+    return (e - 1 - HIST_MIN_EXP) * HIST_SUB_BUCKETS + sub;
+}
+
+// Middle of a bucket, the value reported for everything in it
+static double bucket_value(int b) {
+    int e = b / HIST_SUB_BUCKETS + 1 + HIST_MIN_EXP;
+    double m = 0.5 + (b % HIST_SUB_BUCKETS + 0.5) / (2.0 * HIST_SUB_BUCKETS);
+    return ldexp(m, e);
+}
+
+void hist_add(Histogram *h, double value) {
+    if (h->count == 0 || value < h->min) {
+        h->min = value;
+    }
+    if (h->count == 0 || value > h->max) {
+        h->max = value;
+    }
+    h->count++;
+    h->sum += value;
+    if (value <= 0) {
+        h->zeros++;
+    } else {
+        h->buckets[bucket_of(value)]++;
+    }
+}
+
+double hist_mean(const Histogram *h) {
+    return h->count ? h->sum / h->count : 0.0;
+}
+
+double hist_quantile(const Histogram *h, double q) {
+    if (h->count == 0) {
+        return 0.0;
+    }
+    // Rank of the value wanted, 1-based
+    long rank = (long) ceil(q * h->count);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank <= h->zeros) {
+        return 0.0;
+    }
+    long seen = h->zeros;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            double v = bucket_value(b);
+            // The middle of the first or last bucket may be past the real values
+            return v < h->min ? h->min : v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+void hist_summarize(const Histogram *h, HistSummary *out) {
+    out->mean = hist_mean(h);
+    out->p50 = hist_quantile(h, 0.5);
+    out->p90 = hist_quantile(h, 0.9);
+    out->p99 = hist_quantile(h, 0.99);
+    out->min = h->min;
+    out->max = h->max;
+}
+
+void hist_print(const char *label, const Histogram *h, double scale, const char *unit) {
+    HistSummary s;
+    hist_summarize(h, &s);
+    hist_print_summary(label, &s, scale, unit);
+}
+
+void hist_print_summary(const char *label, const HistSummary *s, double scale, const char *unit) {
+    printf("  %-22s media %.3f%s  p50 %.3f%s  p90 %.3f%s  p99 %.3f%s  máx %.3f%s\n", label,
+           s->mean * scale, unit, s->p50 * scale, unit, s->p90 * scale, unit,
+           s->p99 * scale, unit, s->max * scale, unit);
+}
@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+// --- Streaming histograms ---
+// Fixed memory however many values go in: each power of two is split in
+// HIST_SUB_BUCKETS equal buckets, so a quantile is off by at most 1/16 of its
+// value (log-linear buckets, as in HdrHistogram). Covers 2^HIST_MIN_EXP to
+// 2^HIST_MAX_EXP (about 15 µs to 136 years when the values are seconds);
+// values outside go to the first or last bucket, and min/max stay exact.
+
+#define HIST_SUB_BUCKETS 16
+#define HIST_MIN_EXP -16
+#define HIST_MAX_EXP 32
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_MIN_EXP) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    long count;
+    long zeros;       // Values == 0 (a client who didn't wait at all)
+    double sum;
+    double min;
+    double max;
+    long buckets[HIST_BUCKETS];
+} Histogram;
+
+void hist_init(Histogram *h);
+void hist_add(Histogram *h, double value); // value >= 0
+double hist_mean(const Histogram *h);
+
+// Value below which a fraction q (0..1) of the values fall
+double hist_quantile(const Histogram *h, double q);
+
+// What the summaries show of a histogram, in a few bytes: keep this instead
+// of the histogram when there are many of them
+typedef struct {
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double min;
+    double max;
+} HistSummary;
+
+void hist_summarize(const Histogram *h, HistSummary *out);
+
+// One summary line: mean, p50, p90, p99 and max, each times `scale` and
+// followed by `unit`
+void hist_print(const char *label, const Histogram *h, double scale, const char *unit);
+void hist_print_summary(const char *label, const HistSummary *s, double scale, const char *unit);
+
+#endif
@@ -0,0 +1,133 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sweep.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    SimConfig sim;       // arrivals is only set while the run goes
+    SimSummary summary;
+    long bad_record;     // The workload's record when the run ended
+    int ret;
+} SweepRun;
+
+typedef struct {
+    const SweepConfig *cfg;
+    SweepRun *runs;
+    long n_runs;
+    long next_run;  // Next run to take, shared by the threads
+} SweepJobs;
+
+// Each thread takes runs until there are none left: long and short runs even
+// out without any planning
+static void *sweep_thread(void *arg) {
+    SweepJobs *jobs = arg;
+    SimStats *stats = malloc(sizeof(SimStats)); // Reused by every run of the thread
+    while (1) {
+        long i = __atomic_fetch_add(&jobs->next_run, 1, __ATOMIC_RELAXED);
+        if (i >= jobs->n_runs) {
+            break;
+        }
+        SweepRun *run = &jobs->runs[i];
+        Workload arrivals = *jobs->cfg->arrivals;
+        if (jobs->cfg->auto_rate && arrivals.kind != ARRIVALS_TRACE) {
+            arrivals.rate = 0.9 * run->sim.n_barbers / arrivals.mean_haircut;
+        }
+        run->sim.arrivals = &arrivals;
+        run->ret = stats != NULL ? sim_run(&run->sim, stats) : -1;
+        run->sim.arrivals = NULL;
+        run->bad_record = arrivals.record;
+        if (run->ret == 0) {
+            sim_summarize(stats, &run->summary);
+        }
+    }
+    free(stats);
+    return NULL;
+}
+
+int sweep_run(const SweepConfig *cfg, OutputFormat format, long *bad_record) {
+    SweepJobs jobs = { .cfg = cfg };
+    size_t most = SIZE_MAX / sizeof(SweepRun);
+    if ((size_t) cfg->n_barbers > most / cfg->n_chairs ||
+        (size_t) cfg->n_barbers * cfg->n_chairs > most / cfg->n_policies) {
+        return -1;
+    }
+    jobs.n_runs = (long) cfg->n_barbers * cfg->n_chairs * cfg->n_policies;
+    jobs.runs = malloc(jobs.n_runs * sizeof(SweepRun));
+    if (jobs.runs == NULL) {
+        return -1;
+    }
+
+    // 1. One run per combination, in the order they will be printed
+    long i = 0;
+    for (int b = 0; b < cfg->n_barbers; b++) {
+        for (int c = 0; c < cfg->n_chairs; c++) {
+            for (int p = 0; p < cfg->n_policies; p++) {
+                jobs.runs[i++].sim = (SimConfig) {
+                    .n_barbers = cfg->barbers[b],
+                    .n_chairs = cfg->chairs[c],
+                    .policy = cfg->policies[p],
+                    .outside_limit = cfg->outside_limit,
+                };
+            }
+        }
+    }
+
+    // 2. One thread per core, or fewer if there are fewer runs
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+    if (n_threads > jobs.n_runs) {
+        n_threads = jobs.n_runs;
+    }
+    pthread_t tids[n_threads];
+    long started = 0;
+    while (started < n_threads && pthread_create(&tids[started], NULL, sweep_thread, &jobs) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        sweep_thread(&jobs); // No threads to be had: run them here
+    }
+    for (long t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    // 3. Print in order. A failed run fails the sweep.
+    int ret = 0;
+    for (i = 0; i < jobs.n_runs; i++) {
+        if (jobs.runs[i].ret != 0) {
+            ret = jobs.runs[i].ret;
+            *bad_record = jobs.runs[i].bad_record;
+            break;
+        }
+    }
+    if (ret == 0) {
+        if (format == OUTPUT_CSV) {
+            sim_print_csv_header(stdout);
+        } else if (format == OUTPUT_JSON) {
+            printf("[\n");
+        }
+        for (i = 0; i < jobs.n_runs; i++) {
+            SweepRun *run = &jobs.runs[i];
+            if (format == OUTPUT_CSV) {
+                sim_print_csv(stdout, &run->sim, &run->summary);
+            } else if (format == OUTPUT_JSON) {
+                printf("  ");
+                sim_print_json(stdout, &run->sim, &run->summary);
+                printf(i + 1 < jobs.n_runs ? ",\n" : "\n");
+            } else {
+                sim_print(&run->sim, &run->summary);
+                printf("\n");
+            }
+        }
+        if (format == OUTPUT_JSON) {
+            printf("]\n");
+        }
+    }
+    free(jobs.runs);
+    return ret;
+}
@@ -0,0 +1,31 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+// --- Parameter sweeps ---
+// Runs the headless simulation for every combination of barbers x chairs x
+// policies, each one on the same arrivals: every run gets its own copy of the
+// workload, so a generator replays the same seed and a trace is read again
+// from its start (the mapping is shared, read-only). The runs are independent,
+// so they go to one thread per core, and the results come out in order. Each
+// thread has one SimStats; a run keeps only its SimSummary until it prints.
+
+#include "sim.h"
+
+typedef struct {
+    const int *barbers;
+    int n_barbers;
+    const int *chairs;
+    int n_chairs;
+    const Policy *policies;
+    int n_policies;
+    long outside_limit;
+    int auto_rate;               // Generators: arrivals for 90% of each run's barbers
+    const Workload *arrivals;    // Copied for each run, never advanced
+} SweepConfig;
+
+// Runs the sweep and prints one CSV row or JSON object per run (OUTPUT_TEXT
+// prints the sim_print summaries). Returns 0, -1 if out of memory, or -2 if
+// the workload has a malformed record (its number goes to *bad_record).
+int sweep_run(const SweepConfig *cfg, OutputFormat format, long *bad_record);
+
+#endif
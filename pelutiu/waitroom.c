@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include "waitroom.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define WAITROOM_SPIN 200 // Empty checks before a barber goes to sleep
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() do { } while (0)
+#endif
+
+static const char *kind_names[] = { "locked", "lockfree" };
+
+int waitroom_kind_from_name(const char *name, WaitroomKind *kind) {
+    for (int i = 0; i < (int) (sizeof(kind_names) / sizeof(kind_names[0])); i++) {
+        if (strcmp(name, kind_names[i]) == 0) {
+            *kind = (WaitroomKind) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *waitroom_kind_name(WaitroomKind kind) {
+    return kind_names[kind];
+}
+
+int waitroom_init(Waitroom *w, WaitroomKind kind, int capacity) {
+    memset(w, 0, sizeof(*w));
+    w->kind = kind;
+    w->capacity = capacity;
+    if (kind == WAITROOM_LOCKED) {
+        w->ring = malloc(capacity * sizeof(void *));
+        if (w->ring == NULL) {
+            return -1;
+        }
+        pthread_mutex_init(&w->mutex, NULL);
+        sem_init(&w->customers, 0, 0); // No customers initially
+        return 0;
+    }
+
+    unsigned long n = 2;
+    while (n < (unsigned long) capacity) {
+        n *= 2;
+    }
+    w->cells = malloc(n * sizeof(WaitroomCell));
+    if (w->cells == NULL) {
+        return -1;
+    }
+    // Cell i is free for the putter of lap zero
+    for (unsigned long i = 0; i < n; i++) {
+        w->cells[i].seq = i;
+        w->cells[i].client = NULL;
+    }
+    w->mask = n - 1;
+    // With a single CPU nobody can put while a barber spins: go straight to sleep
+    w->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? WAITROOM_SPIN : 0;
+    return 0;
+}
+
+void waitroom_destroy(Waitroom *w) {
+    if (w->kind == WAITROOM_LOCKED) {
+        pthread_mutex_destroy(&w->mutex);
+        sem_destroy(&w->customers);
+    }
+    free(w->ring);
+    free(w->cells);
+}
+
+// --- Lock-free ring ---
+static void lockfree_put(Waitroom *w, void *client) {
+    unsigned long pos = __atomic_load_n(&w->put_pos, __ATOMIC_RELAXED);
+    while (1) {
+        WaitroomCell *cell = &w->cells[pos & w->mask];
+        unsigned long seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        long diff = (long) (seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&w->put_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                cell->client = client;
+                // Publish: ready for the taker of this lap
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return;
+            }
+            // Another putter won the cell; pos now holds the current index
+        } else {
+            // Behind (another putter advanced) or full; full only lasts until
+            // a taker that already won its index releases the cell, since
+            // callers hold a chair
+            pos = __atomic_load_n(&w->put_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void *lockfree_try_take(Waitroom *w) {
+    unsigned long pos = __atomic_load_n(&w->take_pos, __ATOMIC_RELAXED);
+    while (1) {
+        WaitroomCell *cell = &w->cells[pos & w->mask];
+        unsigned long seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        long diff = (long) (seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&w->take_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                void *client = cell->client;
+                // Free the cell for the putter of the next lap
+                __atomic_store_n(&cell->seq, pos + w->mask + 1, __ATOMIC_RELEASE);
+                return client;
+            }
+        } else if (diff < 0) {
+            return NULL; // Nothing published in this cell yet: empty
+        } else {
+            pos = __atomic_load_n(&w->take_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void *lockfree_take(Waitroom *w) {
+    while (1) {
+        for (int i = 0; i < w->spin; i++) {
+            void *client = lockfree_try_take(w);
+            if (client != NULL) {
+                return client;
+            }
+            cpu_relax();
+        }
+
+        // Register as asleep and look again: a put after this second look
+        // sees the sleeper and wakes it; one before it changed `seated`, so
+        // the futex doesn't sleep
+        unsigned seen = __atomic_load_n(&w->seated, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&w->sleepers, 1, __ATOMIC_SEQ_CST);
+        void *client = lockfree_try_take(w);
+        if (client == NULL) {
+            syscall(SYS_futex, &w->seated, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+        }
+        __atomic_sub_fetch(&w->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (client != NULL) {
+            return client;
+        }
+    }
+}
+
+// --- Interface ---
+void waitroom_put(Waitroom *w, void *client) {
+    if (w->kind == WAITROOM_LOCKED) {
+        pthread_mutex_lock(&w->mutex);
+        w->ring[w->in] = client;
+        w->in = (w->in + 1) % w->capacity;
+        pthread_mutex_unlock(&w->mutex);
+        sem_post(&w->customers);
+        return;
+    }
+
+    lockfree_put(w, client);
+    __atomic_add_fetch(&w->seated, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&w->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        syscall(SYS_futex, &w->seated, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+void *waitroom_take(Waitroom *w) {
+    if (w->kind == WAITROOM_LOCKED) {
+        sem_wait(&w->customers);
+        pthread_mutex_lock(&w->mutex);
+        void *client = w->ring[w->out];
+        w->out = (w->out + 1) % w->capacity;
+        pthread_mutex_unlock(&w->mutex);
+        return client;
+    }
+    return lockfree_take(w);
+}
+
+int waitroom_count(Waitroom *w) {
+    if (w->kind == WAITROOM_LOCKED) {
+        int count;
+        sem_getvalue(&w->customers, &count);
+        return count;
+    }
+    unsigned long take = __atomic_load_n(&w->take_pos, __ATOMIC_RELAXED);
+    unsigned long put = __atomic_load_n(&w->put_pos, __ATOMIC_RELAXED);
+    return put > take ? (int) (put - take) : 0;
+}
@@ -0,0 +1,70 @@
+#ifndef WAITROOM_H
+#define WAITROOM_H
+
+#include <pthread.h>
+#include <semaphore.h>
+
+// --- Waiting room ---
+// The chairs where seated clients wait for a barber: clients are put in
+// arrival order and barbers take them, sleeping while the room is empty.
+// Two implementations, selectable at runtime:
+//  - WAITROOM_LOCKED: the original design, a circular buffer guarded by a
+//    mutex plus a semaphore counting seated clients.
+//  - WAITROOM_LOCKFREE: a bounded MPMC ring (Dmitry Vyukov's): each cell has a
+//    sequence number, so put and take are one compare-and-swap on an index
+//    and no barber waits for another one holding a lock. Barbers spin
+//    briefly on an empty room (with more than one CPU), then sleep on a futex
+//    that every put bumps.
+// Callers only put a client after securing a chair, so the room never holds
+// more than its capacity and put never fails.
+
+typedef enum {
+    WAITROOM_LOCKED,
+    WAITROOM_LOCKFREE,
+} WaitroomKind;
+
+typedef struct {
+    unsigned long seq;
+    void *client;
+} WaitroomCell;
+
+typedef struct {
+    WaitroomKind kind;
+
+    // WAITROOM_LOCKED
+    void **ring;
+    int capacity;
+    int in;
+    int out;
+    pthread_mutex_t mutex;
+    sem_t customers;
+
+    // WAITROOM_LOCKFREE. Each index on its own cache line, so clients and
+    // barbers don't invalidate each other's line on every handoff.
+    WaitroomCell *cells;
+    unsigned long mask;
+    int spin;                                      // Empty checks before sleeping
+    unsigned long put_pos __attribute__((aligned(64)));
+    unsigned long take_pos __attribute__((aligned(64)));
+    unsigned seated __attribute__((aligned(64))); // Futex: bumped by every put
+    int sleepers;                                  // Barbers asleep on `seated`
+} Waitroom;
+
+// Returns 0, or -1 if out of memory.
+int waitroom_init(Waitroom *w, WaitroomKind kind, int capacity);
+void waitroom_destroy(Waitroom *w);
+
+// Seats a client (not NULL); the caller holds one of the `capacity` chairs.
+void waitroom_put(Waitroom *w, void *client);
+
+// Takes the client seated first, sleeping until there is one.
+void *waitroom_take(Waitroom *w);
+
+// Clients currently seated (approximate with WAITROOM_LOCKFREE)
+int waitroom_count(Waitroom *w);
+
+// "locked" / "lockfree"; returns -1 for an unknown name
+int waitroom_kind_from_name(const char *name, WaitroomKind *kind);
+const char *waitroom_kind_name(WaitroomKind kind);
+
+#endif
@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include "workload.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DIURNAL_SWING 0.8 // The rate goes from (1 - swing) to (1 + swing) times the mean
+#define TWO_PI 6.283185307179586
+
+static const char *kind_names[] = { "poisson", "bursty", "diurnal" };
+
+int workload_kind_from_name(const char *name, ArrivalKind *kind) {
+    for (int i = 0; i < (int) (sizeof(kind_names) / sizeof(kind_names[0])); i++) {
+        if (strcmp(name, kind_names[i]) == 0) {
+            *kind = (ArrivalKind) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// --- Random numbers ---
+// xorshift64*: fast and the same sequence on every platform
+static unsigned long long rng_next(Workload *w) {
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return w->rng * 0x2545f4914f6cdd1dULL;
+}
+
+// Uniform in (0, 1)
+static double rng_uniform(Workload *w) {
+    return ((rng_next(w) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double rng_exponential(Workload *w, double mean) {
+    return -log(rng_uniform(w)) * mean;
+}
+
+// --- Generators ---
+void workload_generator(Workload *w, ArrivalKind kind, long n_clients, double rate,
+                        double mean_haircut, unsigned long long seed) {
+    memset(w, 0, sizeof(*w));
+    w->kind = kind;
+    w->remaining = n_clients;
+    w->rate = rate;
+    w->mean_haircut = mean_haircut;
+    w->burst = 8;
+    w->period = 86400;
+    // A seed of 0 would leave xorshift stuck at zero
+    w->rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+}
+
+void workload_shape(Workload *w, double burst, double period) {
+    w->burst = burst;
+    w->period = period;
+}
+
+static double next_time(Workload *w) {
+    switch (w->kind) {
+    case ARRIVALS_BURSTY:
+        if (w->burst_left == 0) {
+            // Groups come at rate / burst, so clients still come at rate
+            w->now += rng_exponential(w, w->burst / w->rate);
+            w->burst_left = 1;
+            if (w->burst > 1) {
+                // Geometric group size with mean `burst`
+                w->burst_left += (long) floor(log(rng_uniform(w)) / log(1 - 1 / w->burst));
+            }
+        }
+        w->burst_left--;
+        return w->now;
+
+    case ARRIVALS_DIURNAL: {
+        // Thinning: candidates at the peak rate, each kept with probability
+        // rate(t) / peak
+        double peak = w->rate * (1 + DIURNAL_SWING);
+        while (1) {
+            w->now += rng_exponential(w, 1 / peak);
+            double level = 1 + DIURNAL_SWING * sin(TWO_PI * w->now / w->period);
+            if (rng_uniform(w) * (1 + DIURNAL_SWING) < level) {
+                return w->now;
+            }
+        }
+    }
+
+    default:
+        w->now += rng_exponential(w, 1 / w->rate);
+        return w->now;
+    }
+}
+
+// --- Trace files ---
+int workload_open_trace(Workload *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+    w->kind = ARRIVALS_TRACE;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    w->size = st.st_size;
+    if (w->size > 0) {
+        void *map = mmap(NULL, w->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        // Read once, front to back: let the kernel read ahead
+        posix_madvise(map, w->size, POSIX_MADV_SEQUENTIAL);
+        w->map = map;
+    }
+    close(fd);
+
+    size_t magic = strlen(TRACE_MAGIC);
+    if (w->size >= magic && memcmp(w->map, TRACE_MAGIC, magic) == 0) {
+        w->binary = 1;
+        w->pos = magic;
+    }
+    return 0;
+}
+
+// Parses a whole field [s, end) as a finite number >= 0
+static int parse_number(const char *s, const char *end, double *out) {
+    char buf[64];
+    while (s < end && (*s == ' ' || *s == '\t')) {
+        s++;
+    }
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    if (end == s || end - s >= (long) sizeof(buf)) {
+        return -1;
+    }
+    // The map has no terminating NUL: strtod works on a copy
+    memcpy(buf, s, end - s);
+    buf[end - s] = '\0';
+    char *rest;
+    *out = strtod(buf, &rest);
+    return *rest == '\0' && isfinite(*out) && *out >= 0 ? 0 : -1;
+}
+
+static void copy_name(char *dst, const char *s, const char *end) {
+    while (s < end && (*s == ' ' || *s == '\t')) {
+        s++;
+    }
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    size_t len = end - s < WORKLOAD_NAME_LEN - 1 ? (size_t) (end - s) : WORKLOAD_NAME_LEN - 1;
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+}
+
+static int next_csv(Workload *w, Arrival *a) {
+    while (w->pos < w->size) {
+        const char *line = w->map + w->pos;
+        const char *eol = memchr(line, '\n', w->size - w->pos);
+        if (eol == NULL) {
+            eol = w->map + w->size; // Last line without a newline
+        }
+        w->pos = eol - w->map + 1;
+        w->record++;
+
+        const char *end = eol;
+        if (end > line && end[-1] == '\r') {
+            end--;
+        }
+        if (end == line || *line == '#') {
+            continue;
+        }
+
+        // time,name,haircut[,priority] (the name may not contain commas)
+        const char *c1 = memchr(line, ',', end - line);
+        const char *c2 = c1 ? memchr(c1 + 1, ',', end - (c1 + 1)) : NULL;
+        int first = !w->header_checked;
+        w->header_checked = 1;
+        if (c2 == NULL || parse_number(line, c1, &a->time) != 0) {
+            if (first) {
+                continue; // Header, maybe after comments
+            }
+            return -1;
+        }
+        const char *c3 = memchr(c2 + 1, ',', end - (c2 + 1));
+        double priority = 0;
+        if (parse_number(c2 + 1, c3 ? c3 : end, &a->haircut) != 0 ||
+            (c3 != NULL && (parse_number(c3 + 1, end, &priority) != 0 || priority != floor(priority) ||
+                            priority > 1000000))) {
+            return -1;
+        }
+        a->priority = (int) priority;
+        copy_name(a->name, c1 + 1, c2);
+        if (a->name[0] == '\0') {
+            return -1;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static int next_binary(Workload *w, Arrival *a) {
+    if (w->pos == w->size) {
+        return 0;
+    }
+    w->record++;
+    if (w->size - w->pos < sizeof(TraceRecord)) {
+        return -1; // Truncated file
+    }
+    TraceRecord r;
+    memcpy(&r, w->map + w->pos, sizeof(r));
+    w->pos += sizeof(r);
+    if (!isfinite(r.time) || r.time < 0 || !isfinite(r.haircut) || r.haircut < 0) {
+        return -1;
+    }
+    a->time = r.time;
+    a->haircut = r.haircut;
+    a->priority = r.priority;
+    size_t len = strnlen(r.name, sizeof(r.name));
+    copy_name(a->name, r.name, r.name + len);
+    return a->name[0] != '\0' ? 1 : -1;
+}
+
+// --- Interface ---
+int workload_next(Workload *w, Arrival *a) {
+    if (w->kind != ARRIVALS_TRACE) {
+        if (w->remaining == 0) {
+            return 0;
+        }
+        w->remaining--;
+        a->time = next_time(w);
+        a->haircut = rng_exponential(w, w->mean_haircut);
+        a->priority = rng_uniform(w) < WORKLOAD_VIP_SHARE;
+        snprintf(a->name, sizeof(a->name), "c%ld", w->next_id++);
+        return 1;
+    }
+
+    int ret = w->binary ? next_binary(w, a) : next_csv(w, a);
+    if (ret == 1) {
+        if (a->time < w->last_time) {
+            return -1;
+        }
+        w->last_time = a->time;
+    }
+    return ret;
+}
+
+void workload_close(Workload *w) {
+    if (w->map != NULL) {
+        munmap((void *) w->map, w->size);
+        w->map = NULL;
+    }
+}
+
+long workload_write_trace(Workload *w, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), f);
+    long written = 0;
+    Arrival a;
+    int ret;
+    while ((ret = workload_next(w, &a)) == 1) {
+        TraceRecord r;
+        memset(&r, 0, sizeof(r));
+        r.time = a.time;
+        r.haircut = a.haircut;
+        r.priority = a.priority;
+        strcpy(r.name, a.name);
+        fwrite(&r, sizeof(r), 1, f);
+        written++;
+    }
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed) {
+        return -1;
+    }
+    return ret < 0 ? -2 : written;
+}
@@ -0,0 +1,105 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stddef.h>
+
+// --- Workloads ---
+// Where clients come from when nobody types them: a built-in generator or a
+// trace file. Both give the same stream of arrivals (time since the start,
+// name, haircut time) in time order, consumed by the headless engine in
+// virtual time and by the TUI feeder in real time.
+//
+// Generators:
+//  - ARRIVALS_POISSON: exponential gaps at `rate` clients per second.
+//  - ARRIVALS_BURSTY:  groups of clients walk in together (geometric size,
+//    mean `burst`); the groups arrive as a Poisson process, so the mean is
+//    still `rate` clients per second.
+//  - ARRIVALS_DIURNAL: Poisson whose rate follows a sine wave of `period`
+//    seconds, between 20% and 180% of `rate`.
+// Haircut times are exponential with mean `mean_haircut`, and one client in
+// ten (WORKLOAD_VIP_SHARE) has priority 1 instead of 0.
+//
+// Trace files, read through mmap so a trace of millions of clients costs no
+// copies and no heap:
+//  - CSV: one client per line, "time,name,haircut[,priority]" (seconds,
+//    seconds, an integer that defaults to 0).
+//    Empty lines and lines starting with '#' are skipped, and so is a first
+//    other line that doesn't start with a number (a header).
+//  - Binary: the 8 bytes "PELUTRC1" followed by TraceRecord structs in
+//    native byte order. --write-trace produces it from any workload.
+// Times must not go backwards.
+
+#define WORKLOAD_NAME_LEN 30 // Same as the TUI's MAX_NAME_LEN
+#define TRACE_MAGIC "PELUTRC1"
+#define WORKLOAD_VIP_SHARE 0.1
+
+typedef enum {
+    ARRIVALS_POISSON,
+    ARRIVALS_BURSTY,
+    ARRIVALS_DIURNAL,
+    ARRIVALS_TRACE,
+} ArrivalKind;
+
+typedef struct {
+    double time;     // Seconds since the start
+    double haircut;  // Seconds
+    int priority;    // Higher goes first with the priority policy
+    char name[WORKLOAD_NAME_LEN];
+} Arrival;
+
+typedef struct {
+    double time;
+    double haircut;
+    int priority;
+    char name[36]; // NUL-terminated; longer names are cut to WORKLOAD_NAME_LEN - 1
+} TraceRecord;
+
+typedef struct {
+    ArrivalKind kind;
+
+    // Generators
+    long remaining;            // Clients still to generate
+    long next_id;              // For the names: c0, c1, ...
+    double rate;
+    double mean_haircut;
+    double burst;
+    double period;
+    double now;
+    long burst_left;           // Clients of the current group not given yet
+    unsigned long long rng;
+
+    // Traces
+    const char *map;
+    size_t size;
+    size_t pos;
+    int binary;
+    long record;               // 1-based line (CSV) or record (binary) just read
+    int header_checked;        // CSV: the first line that isn't empty or '#' was read
+    double last_time;
+} Workload;
+
+// "poisson" / "bursty" / "diurnal"; returns -1 for an unknown name
+int workload_kind_from_name(const char *name, ArrivalKind *kind);
+
+// A generator of n_clients arrivals. Same seed and parameters, same arrivals.
+void workload_generator(Workload *w, ArrivalKind kind, long n_clients, double rate,
+                        double mean_haircut, unsigned long long seed);
+
+// Sets the mean group size (ARRIVALS_BURSTY) and the period (ARRIVALS_DIURNAL)
+void workload_shape(Workload *w, double burst, double period);
+
+// Maps a trace file. Returns 0, or -1 with errno set.
+int workload_open_trace(Workload *w, const char *path);
+
+// Next arrival: returns 1, 0 at the end, or -1 if the record `w->record` is
+// malformed or goes back in time.
+int workload_next(Workload *w, Arrival *a);
+
+void workload_close(Workload *w);
+
+// Writes every remaining arrival of `w` as a binary trace. Returns the number
+// written, -1 with errno set if the file can't be written, or -2 if `w` has a
+// malformed record.
+long workload_write_trace(Workload *w, const char *path);
+
+#endif
@@ -0,0 +1,218 @@
+// Microbenchmark del anillo de toupperd: mide cuánto tiempo se mantiene tomado
+// buffer_mutex por cada fragmento en dos diseños.
+//
+//   copia:       el diseño anterior. El productor llena el espacio del anillo
+//                (48 KiB) y el consumidor lo copia a su pila, ambos con el
+//                mutex tomado.
+//   descriptor:  el diseño actual. Los datos se leen en un buffer del pool
+//                fuera de la región crítica; por el anillo sólo viaja
+//                {puntero, tamaño}.
+//
+// Uso: bench_anillo [fragmentos] [consumidores]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define BUFFER_SIZE 5
+#define CHUNK_SIZE (48 * 1024)
+
+typedef struct {
+    char content[CHUNK_SIZE];
+    long size;
+} Espacio;
+
+typedef struct {
+    char *content;
+    long size;
+} Descriptor;
+
+static Espacio anillo_copia[BUFFER_SIZE];
+static Descriptor anillo_desc[BUFFER_SIZE];
+static int buffer_in, buffer_out;
+static sem_t sem_full, sem_empty, sem_pool;
+static pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char **pool_libres;
+static int pool_libres_n;
+
+static int g_modo_descriptor;
+static long g_fragmentos;
+static int g_consumidores;
+static char g_origen[CHUNK_SIZE]; // Hace de archivo ya en la caché de páginas
+
+// Tiempos de retención del mutex en nanosegundos, uno por región crítica
+static long *retenciones;
+static long retenciones_n;
+static pthread_mutex_t retenciones_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long ahora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void anotar(long *locales, long n) {
+    pthread_mutex_lock(&retenciones_mutex);
+    memcpy(retenciones + retenciones_n, locales, n * sizeof(long));
+    retenciones_n += n;
+    pthread_mutex_unlock(&retenciones_mutex);
+}
+
+static char *tomar_buffer(void) {
+    sem_wait(&sem_pool);
+    pthread_mutex_lock(&pool_mutex);
+    char *buffer = pool_libres[--pool_libres_n];
+    pthread_mutex_unlock(&pool_mutex);
+    return buffer;
+}
+
+static void devolver_buffer(char *buffer) {
+    pthread_mutex_lock(&pool_mutex);
+    pool_libres[pool_libres_n++] = buffer;
+    pthread_mutex_unlock(&pool_mutex);
+    sem_post(&sem_pool);
+}
+
+static void *productor(void *arg) {
+    long *locales = malloc(g_fragmentos * sizeof(long));
+
+    for (long i = 0; i < g_fragmentos; i++) {
+        char *buffer = NULL;
+        if (g_modo_descriptor) {
+            buffer = tomar_buffer();
+            memcpy(buffer, g_origen, CHUNK_SIZE);
+        }
+
+        sem_wait(&sem_empty);
+        pthread_mutex_lock(&buffer_mutex);
+        long t0 = ahora_ns();
+        if (g_modo_descriptor) {
+            anillo_desc[buffer_in] = (Descriptor) { buffer, CHUNK_SIZE };
+        } else {
+            memcpy(anillo_copia[buffer_in].content, g_origen, CHUNK_SIZE);
+            anillo_copia[buffer_in].size = CHUNK_SIZE;
+        }
+        buffer_in = (buffer_in + 1) % BUFFER_SIZE;
+        locales[i] = ahora_ns() - t0;
+        pthread_mutex_unlock(&buffer_mutex);
+        sem_post(&sem_full);
+    }
+
+    anotar(locales, g_fragmentos);
+    free(locales);
+    return NULL;
+}
+
+static void *consumidor(void *arg) {
+    long cuota = *(long *) arg;
+    long *locales = malloc(cuota * sizeof(long));
+    char *copia = malloc(CHUNK_SIZE);
+    volatile char sumidero = 0;
+
+    for (long i = 0; i < cuota; i++) {
+        sem_wait(&sem_full);
+        pthread_mutex_lock(&buffer_mutex);
+        long t0 = ahora_ns();
+        Descriptor d = { NULL, 0 };
+        if (g_modo_descriptor) {
+            d = anillo_desc[buffer_out];
+        } else {
+            memcpy(copia, anillo_copia[buffer_out].content, anillo_copia[buffer_out].size);
+        }
+        buffer_out = (buffer_out + 1) % BUFFER_SIZE;
+        locales[i] = ahora_ns() - t0;
+        pthread_mutex_unlock(&buffer_mutex);
+        sem_post(&sem_empty);
+
+        if (g_modo_descriptor) {
+            sumidero ^= d.content[d.size - 1];
+            devolver_buffer(d.content);
+        } else {
+            sumidero ^= copia[CHUNK_SIZE - 1];
+        }
+    }
+
+    anotar(locales, cuota);
+    free(locales);
+    free(copia);
+    return NULL;
+}
+
+static int comparar_long(const void *a, const void *b) {
+    long x = *(const long *) a, y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+static void correr(int modo_descriptor) {
+    g_modo_descriptor = modo_descriptor;
+    buffer_in = buffer_out = 0;
+    retenciones_n = 0;
+    sem_init(&sem_full, 0, 0);
+    sem_init(&sem_empty, 0, BUFFER_SIZE);
+
+    int pool_size = BUFFER_SIZE + g_consumidores + 1;
+    pool_libres = malloc(pool_size * sizeof(char *));
+    pool_libres_n = 0;
+    for (int i = 0; i < pool_size; i++) {
+        pool_libres[pool_libres_n++] = malloc(CHUNK_SIZE);
+    }
+    sem_init(&sem_pool, 0, pool_size);
+
+    pthread_t prod, cons[g_consumidores];
+    long cuotas[g_consumidores];
+    long t0 = ahora_ns();
+    pthread_create(&prod, NULL, productor, NULL);
+    for (int i = 0; i < g_consumidores; i++) {
+        cuotas[i] = g_fragmentos / g_consumidores + (i < g_fragmentos % g_consumidores);
+        pthread_create(&cons[i], NULL, consumidor, &cuotas[i]);
+    }
+    pthread_join(prod, NULL);
+    for (int i = 0; i < g_consumidores; i++) {
+        pthread_join(cons[i], NULL);
+    }
+    double segundos = (ahora_ns() - t0) / 1e9;
+
+    qsort(retenciones, retenciones_n, sizeof(long), comparar_long);
+    double media = 0;
+    for (long i = 0; i < retenciones_n; i++) {
+        media += retenciones[i];
+    }
+    media /= retenciones_n;
+
+    printf("%-11s retención media %8.0f ns  p50 %7ld ns  p99 %7ld ns  max %8ld ns  | %8.0f fragmentos/s\n",
+           modo_descriptor ? "descriptor" : "copia", media,
+           retenciones[retenciones_n / 2], retenciones[retenciones_n * 99 / 100],
+           retenciones[retenciones_n - 1], g_fragmentos / segundos);
+
+    while (pool_libres_n > 0) {
+        free(pool_libres[--pool_libres_n]);
+    }
+    free(pool_libres);
+    sem_destroy(&sem_full);
+    sem_destroy(&sem_empty);
+    sem_destroy(&sem_pool);
+}
+
+int main(int argc, char *argv[]) {
+    g_fragmentos = argc > 1 ? atol(argv[1]) : 200000;
+    g_consumidores = argc > 2 ? atoi(argv[2]) : 2;
+    if (g_fragmentos <= 0 || g_consumidores <= 0) {
+        fprintf(stderr, "Uso: bench_anillo [fragmentos] [consumidores]\n");
+        return 1;
+    }
+
+    memset(g_origen, 'a', sizeof(g_origen));
+    retenciones = malloc(2 * g_fragmentos * sizeof(long));
+
+    printf("bench_anillo: %ld fragmentos de %d KiB, %d consumidores, anillo de %d espacios\n",
+           g_fragmentos, CHUNK_SIZE / 1024, g_consumidores, BUFFER_SIZE);
+    correr(0);
+    correr(1);
+
+    free(retenciones);
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Benchmark del núcleo de conversión a mayúsculas (mayus.c).
+//
+// Antes de medir, compara cada variante disponible contra toupper() sobre
+// buffers aleatorios de largos y alineaciones aleatorias, y su versión UTF-8
+// contra la escalar y contra casos conocidos: si alguna difiere en un solo
+// byte, el benchmark aborta. Después mide el rendimiento en GB/s, en modo ASCII
+// y en modo UTF-8 con texto en puro ASCII y con texto en español.
+//
+// Uso: bench_mayus [MiB] [repeticiones]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "../mayus.h"
+
+#define PRUEBAS_DIFERENCIALES 20000
+#define LARGO_MAXIMO_PRUEBA 300
+
+static double ahora(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Compara la variante contra toupper() en la locale "C". Devuelve 0 si coincide.
+static int verificar(const MayusVariante *v, unsigned int semilla) {
+    char original[LARGO_MAXIMO_PRUEBA + 64];
+    char esperado[LARGO_MAXIMO_PRUEBA + 64];
+    char obtenido[LARGO_MAXIMO_PRUEBA + 64];
+
+    srand(semilla);
+    for (int prueba = 0; prueba < PRUEBAS_DIFERENCIALES; prueba++) {
+        size_t largo = rand() % LARGO_MAXIMO_PRUEBA;
+        size_t alineacion = rand() % 64;
+
+        for (size_t i = 0; i < sizeof(original); i++) {
+            original[i] = (char) (rand() & 0xff);
+        }
+        memcpy(esperado, original, sizeof(original));
+        memcpy(obtenido, original, sizeof(original));
+        for (size_t i = 0; i < largo; i++) {
+            esperado[alineacion + i] = toupper((unsigned char) esperado[alineacion + i]);
+        }
+        v->convertir(obtenido + alineacion, largo);
+
+        if (memcmp(esperado, obtenido, sizeof(original)) != 0) {
+            fprintf(stderr, "%s: difiere de toupper() (largo %zu, alineación %zu, semilla %u)\n",
+                    v->nombre, largo, alineacion, semilla);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Piezas para armar texto UTF-8 de prueba: ASCII, letras de 2, 3 y 4 bytes con
+// y sin mayúscula, y secuencias cortadas o inválidas
+static const char *piezas[] = {
+    "a", "Z", " ", "hola", "á", "é", "í", "ó", "ú", "ñ", "ü", "Ñ", "¿", "¡", "ß", "ÿ",
+    "α", "ω", "ж", "ё", "ա", "ḁ", "ẞ", "ａ", "ｚ", "€", "\xf0\x90\x90\xa8", "\xf0\x9f\x98\x80",
+    "\xc3", "\xe2\x82", "\x80", "\xff", "\xc0\xaf", "\xe0\x80\x80", "\xed\xa0\x80",
+};
+
+#define PIEZAS (sizeof(piezas) / sizeof(piezas[0]))
+
+// Casos conocidos del modo UTF-8
+static const char *casos[][2] = {
+    { "¡Hola, señor Müller! ¿Qué tal?", "¡HOLA, SEÑOR MÜLLER! ¿QUÉ TAL?" },
+    { "árbol, ñandú, pingüino, acción", "ÁRBOL, ÑANDÚ, PINGÜINO, ACCIÓN" },
+    { "αβγ жёлтый ḁ ａｂｃ \xf0\x90\x90\xa8", "ΑΒΓ ЖЁЛТЫЙ Ḁ ＡＢＣ \xf0\x90\x90\x80" },
+    { "straße ı ÿ µ", "STRAßE ı Ÿ Μ" },
+};
+
+// Compara la versión UTF-8 de la variante contra la escalar y contra los casos
+// conocidos. Devuelve 0 si coincide.
+static int verificar_utf8(const MayusVariante *v, const MayusVariante *referencia, unsigned int semilla) {
+    char original[LARGO_MAXIMO_PRUEBA + 64];
+    char esperado[LARGO_MAXIMO_PRUEBA + 64];
+    char obtenido[LARGO_MAXIMO_PRUEBA + 64];
+
+    for (size_t c = 0; c < sizeof(casos) / sizeof(casos[0]); c++) {
+        size_t largo = strlen(casos[c][0]);
+        memcpy(obtenido, casos[c][0], largo + 1);
+        v->convertir_utf8(obtenido, largo);
+        if (strcmp(obtenido, casos[c][1]) != 0) {
+            fprintf(stderr, "%s: UTF-8 convierte \"%s\" en \"%s\"\n", v->nombre, casos[c][0], obtenido);
+            return -1;
+        }
+    }
+
+    srand(semilla);
+    for (int prueba = 0; prueba < PRUEBAS_DIFERENCIALES; prueba++) {
+        size_t largo = rand() % LARGO_MAXIMO_PRUEBA;
+        size_t alineacion = rand() % 64;
+
+        size_t i = 0;
+        while (i < sizeof(original)) {
+            const char *pieza = piezas[rand() % PIEZAS];
+            size_t n = strlen(pieza);
+            if (i + n > sizeof(original)) {
+                n = sizeof(original) - i;
+            }
+            memcpy(original + i, pieza, n);
+            i += n;
+        }
+        memcpy(esperado, original, sizeof(original));
+        memcpy(obtenido, original, sizeof(original));
+        referencia->convertir_utf8(esperado + alineacion, largo);
+        v->convertir_utf8(obtenido + alineacion, largo);
+
+        if (memcmp(esperado, obtenido, sizeof(original)) != 0) {
+            fprintf(stderr, "%s: UTF-8 difiere de la escalar (largo %zu, alineación %zu, semilla %u)\n",
+                    v->nombre, largo, alineacion, semilla);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Mide la función sobre el texto y devuelve GB/s
+static double medir(mayus_fn convertir, char *texto, size_t largo, int repeticiones) {
+    convertir(texto, largo); // Calentamiento
+    double t0 = ahora();
+    for (int r = 0; r < repeticiones; r++) {
+        convertir(texto, largo);
+    }
+    return (double) largo * repeticiones / (ahora() - t0) / 1e9;
+}
+
+// Texto imprimible con mezcla de minúsculas y mayúsculas; se regenera para que
+// cada variante trabaje sobre los mismos datos
+static void texto_ascii(char *texto, size_t largo) {
+    srand(1);
+    for (size_t i = 0; i < largo; i++) {
+        texto[i] = (char) (' ' + rand() % 95);
+    }
+}
+
+// Texto en español: palabras al azar, con tildes y eñes como en un texto real
+static void texto_espanol(char *texto, size_t largo) {
+    static const char *palabras[] = {
+        "el ", "de ", "que ", "la ", "en ", "y ", "los ", "se ", "del ", "las ", "un ", "por ",
+        "con ", "para ", "una ", "más ", "también ", "está ", "según ", "país ", "año ",
+        "información ", "política ", "niños ", "después ", "economía ", "pingüino ", "¿cómo? ",
+    };
+    srand(1);
+    size_t i = 0;
+    while (i < largo) {
+        const char *p = palabras[rand() % (sizeof(palabras) / sizeof(palabras[0]))];
+        size_t n = strlen(p);
+        if (i + n > largo) {
+            memset(texto + i, ' ', largo - i);
+            break;
+        }
+        memcpy(texto + i, p, n);
+        i += n;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t mib = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+    int repeticiones = argc > 2 ? atoi(argv[2]) : 20;
+    if (mib == 0 || repeticiones <= 0) {
+        fprintf(stderr, "Uso: bench_mayus [MiB] [repeticiones]\n");
+        return 1;
+    }
+
+    size_t largo = mib << 20;
+    char *texto = malloc(largo);
+    if (texto == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    int cantidad;
+    const MayusVariante *variantes = mayus_variantes(&cantidad);
+    printf("bench_mayus: %zu MiB x %d repeticiones, variante elegida: %s\n",
+           mib, repeticiones, mayus_iniciar(1));
+
+    for (int v = 0; v < cantidad; v++) {
+        if (!variantes[v].disponible()) {
+            printf("%-10s no soportada por esta CPU\n", variantes[v].nombre);
+            continue;
+        }
+        unsigned int semilla = (unsigned int) time(NULL);
+        if (verificar(&variantes[v], semilla) != 0 ||
+            verificar_utf8(&variantes[v], &variantes[0], semilla) != 0) {
+            return 1;
+        }
+
+        texto_ascii(texto, largo);
+        double ascii = medir(variantes[v].convertir, texto, largo, repeticiones);
+        texto_ascii(texto, largo);
+        double utf8_ascii = medir(variantes[v].convertir_utf8, texto, largo, repeticiones);
+        texto_espanol(texto, largo);
+        double utf8_espanol = medir(variantes[v].convertir_utf8, texto, largo, repeticiones);
+
+        printf("%-10s verificada  ascii %7.2f GB/s  utf8: texto ascii %7.2f GB/s, en español %7.2f GB/s\n",
+               variantes[v].nombre, ascii, utf8_ascii, utf8_espanol);
+    }
+
+    free(texto);
+    return 0;
+}
@@ -0,0 +1,461 @@
+// Benchmark de punta a punta de toupperd.
+//
+// Para cada directorio de trabajo (por defecto un tmpfs, /dev/shm, y un disco,
+// /var/tmp) y cada motor de E/S:
+//   1. genera el corpus con bench/corpus en <dir>/corpus, fuera del origen;
+//   2. arranca toupperd sobre <dir>/in y <dir>/out;
+//   3. mueve los archivos del corpus a in con rename(), de golpe o a una tasa
+//      fija, anotando cuándo entró cada uno;
+//   4. un hilo vigila out con inotify y anota cuándo aparece cada resultado,
+//      que toupperd sólo renombra ahí cuando ya está en disco;
+//   5. detiene toupperd y toma su tiempo de CPU con wait4().
+// La latencia de cada archivo va de su rename() a in hasta su aparición en
+// out. El resultado es un JSON con archivos/s, MB/s, p50/p99 de latencia y
+// segundos de CPU por GB, para comparar versiones.
+//
+// Uso: bench_toupperd [-n archivos] [-t tamaño_medio] [-d distribución]
+//                     [-u fracción_utf8] [-s semilla] [-e motor,motor...]
+//                     [-j consumidores] [-r archivos_por_segundo]
+//                     [-V versión] [-o salida.json] [directorio...]
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+
+#define TMPFS_MAGIC 0x01021994
+#define SIN_PROGRESO_S 30 // Se abandona la corrida si nada llega en este tiempo
+#define MOTORES_MAX 8
+#define DIR_MAX (PATH_MAX / 2) // Directorios de trabajo; las rutas adentro, PATH_MAX
+
+typedef struct {
+    const char *directorio;
+    const char *motor;
+    long archivos;
+    long completados;
+    long long bytes;
+    double segundos;     // Del primer rename() a la última llegada
+    double latencia_p50; // Segundos
+    double latencia_p99;
+    double cpu_segundos; // Usuario + sistema de toupperd
+    int desbordes;       // Eventos de inotify perdidos (latencias aproximadas)
+} Resultado;
+
+// Parámetros del corpus, que se pasan tal cual a bench/corpus
+static const char *p_archivos = "10000";
+static const char *p_tamano = "4096";
+static const char *p_distribucion = "fija";
+static const char *p_utf8 = "0.2";
+static const char *p_semilla = "1";
+
+static char ruta_toupperd[PATH_MAX];
+static char ruta_corpus[PATH_MAX];
+static const char *consumidores = NULL;
+static double tasa = 0; // Archivos por segundo; 0: todos de golpe
+
+// Llegadas a out, las anota el hilo vigía
+static long *llegada_ns;
+static long llegados;
+static int vigia_terminar;
+static int vigia_desbordes;
+
+static long ahora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Índice de un archivo del corpus (f0000123 -> 123), o -1
+static long indice_archivo(const char *nombre, long archivos) {
+    char *fin;
+    if (nombre[0] != 'f') {
+        return -1;
+    }
+    long i = strtol(nombre + 1, &fin, 10);
+    return *fin == '\0' && i >= 0 && i < archivos ? i : -1;
+}
+
+static void anotar_llegada(const char *nombre, long archivos, long cuando) {
+    long i = indice_archivo(nombre, archivos);
+    if (i >= 0 && llegada_ns[i] == 0) {
+        llegada_ns[i] = cuando;
+        __atomic_add_fetch(&llegados, 1, __ATOMIC_RELEASE);
+    }
+}
+
+typedef struct {
+    int fd;
+    const char *salida;
+    long archivos;
+} Vigia;
+
+static void *hilo_vigia(void *arg) {
+    Vigia *v = arg;
+    char eventos[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = v->fd, .events = POLLIN };
+
+    while (!__atomic_load_n(&vigia_terminar, __ATOMIC_ACQUIRE)) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        ssize_t len = read(v->fd, eventos, sizeof(eventos));
+        long cuando = ahora_ns();
+        for (char *p = eventos; len > 0 && p < eventos + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // Se perdieron eventos: lo que ya está en out llegó hasta ahora
+                vigia_desbordes++;
+                DIR *d = opendir(v->salida);
+                struct dirent *e;
+                while (d != NULL && (e = readdir(d)) != NULL) {
+                    anotar_llegada(e->d_name, v->archivos, cuando);
+                }
+                if (d != NULL) {
+                    closedir(d);
+                }
+            } else if (ev->len > 0) {
+                anotar_llegada(ev->name, v->archivos, cuando);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int comparar_long(const void *a, const void *b) {
+    long x = *(const long *) a, y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+// Ejecuta un programa y espera a que termine. Devuelve su código de salida.
+// Lo que escriba va a stderr: stdout es del JSON.
+static int ejecutar(char *const argv[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int estado;
+    if (pid < 0 || waitpid(pid, &estado, 0) < 0) {
+        return -1;
+    }
+    return WIFEXITED(estado) ? WEXITSTATUS(estado) : -1;
+}
+
+static int borrar(const char *ruta) {
+    char *argv[] = { "/bin/rm", "-rf", (char *) ruta, NULL };
+    return ejecutar(argv);
+}
+
+static int correr(const char *base, const char *motor, Resultado *r) {
+    char dir[DIR_MAX], corpus[DIR_MAX + 16], entrada[DIR_MAX + 16], salida[DIR_MAX + 16];
+    snprintf(dir, sizeof(dir), "%s/toupperd-bench.%d", base, (int) getpid());
+    snprintf(corpus, sizeof(corpus), "%s/corpus", dir);
+    snprintf(entrada, sizeof(entrada), "%s/in", dir);
+    snprintf(salida, sizeof(salida), "%s/out", dir);
+
+    memset(r, 0, sizeof(*r));
+    r->directorio = base;
+    r->motor = motor;
+    r->archivos = atol(p_archivos);
+
+    // 1. Corpus, en el mismo sistema de archivos para que rename() sea atómico
+    borrar(dir);
+    if (mkdir(dir, 0755) != 0 || mkdir(corpus, 0755) != 0 || mkdir(entrada, 0755) != 0 ||
+        mkdir(salida, 0755) != 0) {
+        fprintf(stderr, "bench_toupperd: Error creando %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    char *argv_corpus[] = { ruta_corpus, "-n", (char *) p_archivos, "-t", (char *) p_tamano,
+                            "-d", (char *) p_distribucion, "-u", (char *) p_utf8,
+                            "-s", (char *) p_semilla, corpus, NULL };
+    if (ejecutar(argv_corpus) != 0) {
+        borrar(dir);
+        return -1;
+    }
+    for (long i = 0; i < r->archivos; i++) {
+        char ruta[PATH_MAX];
+        struct stat st;
+        snprintf(ruta, sizeof(ruta), "%s/f%07ld", corpus, i);
+        if (stat(ruta, &st) == 0) {
+            r->bytes += st.st_size;
+        }
+    }
+    sync();
+
+    // 2. Vigilar out antes de que pueda aparecer nada
+    llegada_ns = calloc(r->archivos, sizeof(long));
+    long *entrada_ns = calloc(r->archivos, sizeof(long));
+    llegados = 0;
+    vigia_terminar = 0;
+    vigia_desbordes = 0;
+    Vigia vigia = { .fd = inotify_init1(IN_CLOEXEC), .salida = salida, .archivos = r->archivos };
+    if (llegada_ns == NULL || entrada_ns == NULL || vigia.fd < 0 ||
+        inotify_add_watch(vigia.fd, salida, IN_MOVED_TO) < 0) {
+        fprintf(stderr, "bench_toupperd: Error preparando la vigilancia de %s\n", salida);
+        return -1;
+    }
+    pthread_t vigia_tid;
+    pthread_create(&vigia_tid, NULL, hilo_vigia, &vigia);
+
+    // 3. Arrancar toupperd con la salida descartada
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        if (consumidores != NULL) {
+            execl(ruta_toupperd, ruta_toupperd, "-e", motor, "-j", consumidores, entrada, salida, (char *) NULL);
+        } else {
+            execl(ruta_toupperd, ruta_toupperd, "-e", motor, entrada, salida, (char *) NULL);
+        }
+        _exit(127);
+    }
+
+    // El diario aparece antes de que arranquen los hilos; lo que llegue antes
+    // de que el productor vigile in lo levanta su escaneo inicial
+    char diario[PATH_MAX];
+    snprintf(diario, sizeof(diario), "%s/.toupperd.diario", salida);
+    struct stat st;
+    while (stat(diario, &st) != 0 && waitpid(pid, NULL, WNOHANG) == 0) {
+        usleep(1000);
+    }
+    usleep(50000);
+
+    // 4. Mover el corpus a in
+    long inicio = ahora_ns();
+    for (long i = 0; i < r->archivos; i++) {
+        if (tasa > 0) {
+            long objetivo = inicio + (long) (i * 1e9 / tasa);
+            struct timespec ts = { .tv_sec = objetivo / 1000000000L, .tv_nsec = objetivo % 1000000000L };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        char desde[PATH_MAX], hacia[PATH_MAX];
+        snprintf(desde, sizeof(desde), "%s/f%07ld", corpus, i);
+        snprintf(hacia, sizeof(hacia), "%s/f%07ld", entrada, i);
+        entrada_ns[i] = ahora_ns();
+        if (rename(desde, hacia) != 0) {
+            fprintf(stderr, "bench_toupperd: Error moviendo %s: %s\n", desde, strerror(errno));
+        }
+    }
+
+    // 5. Esperar a que lleguen todos, mientras haya progreso
+    long visto = -1, progreso = ahora_ns();
+    while (__atomic_load_n(&llegados, __ATOMIC_ACQUIRE) < r->archivos) {
+        long n = __atomic_load_n(&llegados, __ATOMIC_ACQUIRE);
+        if (n != visto) {
+            visto = n;
+            progreso = ahora_ns();
+        } else if (ahora_ns() - progreso > SIN_PROGRESO_S * 1000000000L) {
+            fprintf(stderr, "bench_toupperd: %s/%s: sin progreso en %d s, %ld de %ld archivos\n",
+                    base, motor, SIN_PROGRESO_S, n, r->archivos);
+            break;
+        }
+        usleep(1000);
+    }
+
+    kill(pid, SIGTERM);
+    struct rusage uso;
+    wait4(pid, NULL, 0, &uso);
+    __atomic_store_n(&vigia_terminar, 1, __ATOMIC_RELEASE);
+    pthread_join(vigia_tid, NULL);
+    close(vigia.fd);
+
+    r->cpu_segundos = uso.ru_utime.tv_sec + uso.ru_utime.tv_usec / 1e6 +
+                      uso.ru_stime.tv_sec + uso.ru_stime.tv_usec / 1e6;
+    r->desbordes = vigia_desbordes;
+
+    // Latencias de los que llegaron
+    long ultimo = inicio;
+    for (long i = 0; i < r->archivos; i++) {
+        if (llegada_ns[i] == 0) {
+            continue;
+        }
+        if (llegada_ns[i] > ultimo) {
+            ultimo = llegada_ns[i];
+        }
+        entrada_ns[r->completados++] = llegada_ns[i] - entrada_ns[i];
+    }
+    r->segundos = (ultimo - inicio) / 1e9;
+    if (r->completados > 0) {
+        qsort(entrada_ns, r->completados, sizeof(long), comparar_long);
+        r->latencia_p50 = entrada_ns[(r->completados - 1) * 50 / 100] / 1e9;
+        r->latencia_p99 = entrada_ns[(r->completados - 1) * 99 / 100] / 1e9;
+    }
+
+    free(llegada_ns);
+    free(entrada_ns);
+    borrar(dir);
+    return 0;
+}
+
+static const char *tipo_sistema_archivos(const char *dir) {
+    struct statfs sf;
+    if (statfs(dir, &sf) != 0) {
+        return "desconocido";
+    }
+    return sf.f_type == TMPFS_MAGIC ? "tmpfs" : "disco";
+}
+
+// Escribe `valor` como cadena JSON, entre comillas y con \, " y los
+// caracteres de control escapados (una ruta puede tener cualquiera)
+static void escribir_cadena(FILE *f, const char *valor) {
+    fputc('"', f);
+    for (const unsigned char *p = (const unsigned char *) valor; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(f, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(f, "\\u%04x", *p);
+        } else {
+            fputc(*p, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void escribir_json(FILE *f, const char *version, Resultado *resultados, int n) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"version\": ");
+    escribir_cadena(f, version);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"fecha\": %ld,\n", (long) time(NULL));
+    fprintf(f, "  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(f, "  \"corpus\": {\"archivos\": %ld, \"tamano_medio\": %ld, \"distribucion\": ",
+            atol(p_archivos), atol(p_tamano));
+    escribir_cadena(f, p_distribucion);
+    fprintf(f, ", \"fraccion_utf8\": %g, \"semilla\": %llu},\n", atof(p_utf8),
+            strtoull(p_semilla, NULL, 10));
+    fprintf(f, "  \"tasa\": %.0f,\n", tasa);
+    fprintf(f, "  \"resultados\": [\n");
+    for (int i = 0; i < n; i++) {
+        Resultado *r = &resultados[i];
+        double gb = r->bytes / 1e9;
+        double segundos = r->segundos > 0 ? r->segundos : 1e-9;
+        fprintf(f, "    {\"directorio\": ");
+        escribir_cadena(f, r->directorio);
+        fprintf(f, ", \"tipo\": ");
+        escribir_cadena(f, tipo_sistema_archivos(r->directorio));
+        fprintf(f, ", \"motor\": ");
+        escribir_cadena(f, r->motor);
+        fprintf(f, ", ");
+        fprintf(f, "\"archivos\": %ld, \"completados\": %ld, \"bytes\": %lld, \"segundos\": %.6f, ",
+                r->archivos, r->completados, r->bytes, r->segundos);
+        fprintf(f, "\"archivos_s\": %.1f, \"mb_s\": %.2f, ", r->completados / segundos,
+                r->bytes / 1e6 / segundos);
+        fprintf(f, "\"latencia_p50_ms\": %.3f, \"latencia_p99_ms\": %.3f, ", r->latencia_p50 * 1e3,
+                r->latencia_p99 * 1e3);
+        fprintf(f, "\"cpu_segundos\": %.3f, \"cpu_segundos_por_gb\": %.3f, \"desbordes\": %d}%s\n",
+                r->cpu_segundos, gb > 0 ? r->cpu_segundos / gb : 0, r->desbordes,
+                i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+
+static void print_usage(void) {
+    fprintf(stderr, "Uso: bench_toupperd [-n archivos] [-t tamaño_medio] [-d distribución]\n");
+    fprintf(stderr, "                    [-u fracción_utf8] [-s semilla] [-e motor,motor...]\n");
+    fprintf(stderr, "                    [-j consumidores] [-r archivos_por_segundo]\n");
+    fprintf(stderr, "                    [-V versión] [-o salida.json] [directorio...]\n");
+}
+
+int main(int argc, char *argv[]) {
+    char motores_texto[256] = "stdio,mmap";
+    const char *version = "desconocida";
+    const char *archivo_salida = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:d:u:s:e:j:r:V:o:")) != -1) {
+        switch (opt) {
+        case 'n': p_archivos = optarg; break;
+        case 't': p_tamano = optarg; break;
+        case 'd': p_distribucion = optarg; break;
+        case 'u': p_utf8 = optarg; break;
+        case 's': p_semilla = optarg; break;
+        case 'e': snprintf(motores_texto, sizeof(motores_texto), "%s", optarg); break;
+        case 'j': consumidores = optarg; break;
+        case 'r': tasa = atof(optarg); break;
+        case 'V': version = optarg; break;
+        case 'o': archivo_salida = optarg; break;
+        default:
+            print_usage();
+            return 1;
+        }
+    }
+    if (atol(p_archivos) <= 0) {
+        print_usage();
+        return 1;
+    }
+
+    // toupperd y corpus se buscan relativos a este ejecutable
+    char propio[DIR_MAX];
+    snprintf(propio, sizeof(propio), "%s", argv[0]);
+    char *barra = strrchr(propio, '/');
+    const char *bench_dir = barra != NULL ? (*barra = '\0', propio) : ".";
+    snprintf(ruta_toupperd, sizeof(ruta_toupperd), "%s/../toupperd", bench_dir);
+    snprintf(ruta_corpus, sizeof(ruta_corpus), "%s/corpus", bench_dir);
+    if (access(ruta_toupperd, X_OK) != 0 || access(ruta_corpus, X_OK) != 0) {
+        fprintf(stderr, "bench_toupperd: falta %s o %s (correr make bench)\n", ruta_toupperd, ruta_corpus);
+        return 1;
+    }
+
+    const char *directorios_defecto[] = { "/dev/shm", "/var/tmp" };
+    const char **directorios = (const char **) argv + optind;
+    int num_directorios = argc - optind;
+    if (num_directorios == 0) {
+        directorios = directorios_defecto;
+        num_directorios = 2;
+    }
+
+    const char *motores[MOTORES_MAX];
+    int num_motores = 0;
+    for (char *m = strtok(motores_texto, ","); m != NULL && num_motores < MOTORES_MAX; m = strtok(NULL, ",")) {
+        motores[num_motores++] = m;
+    }
+
+    Resultado *resultados = calloc(num_directorios * num_motores, sizeof(Resultado));
+    if (resultados == NULL) {
+        perror("bench_toupperd: Error reservando memoria");
+        return 1;
+    }
+    int n = 0;
+    for (int d = 0; d < num_directorios; d++) {
+        for (int m = 0; m < num_motores; m++) {
+            if (correr(directorios[d], motores[m], &resultados[n]) != 0) {
+                continue;
+            }
+            Resultado *r = &resultados[n++];
+            double segundos = r->segundos > 0 ? r->segundos : 1e-9;
+            fprintf(stderr, "%s (%s) %s: %ld/%ld archivos, %.0f archivos/s, %.1f MB/s, "
+                            "p50 %.2f ms, p99 %.2f ms, %.2f s CPU/GB\n",
+                    r->directorio, tipo_sistema_archivos(r->directorio), r->motor, r->completados,
+                    r->archivos, r->completados / segundos, r->bytes / 1e6 / segundos,
+                    r->latencia_p50 * 1e3, r->latencia_p99 * 1e3,
+                    r->bytes > 0 ? r->cpu_segundos / (r->bytes / 1e9) : 0);
+        }
+    }
+
+    FILE *f = stdout;
+    if (archivo_salida != NULL && (f = fopen(archivo_salida, "w")) == NULL) {
+        fprintf(stderr, "bench_toupperd: Error abriendo %s: %s\n", archivo_salida, strerror(errno));
+        return 1;
+    }
+    escribir_json(f, version, resultados, n);
+    if (f != stdout) {
+        fclose(f);
+    }
+    free(resultados);
+    return 0;
+}
@@ -0,0 +1,188 @@
+// Generador de corpus sintético para los benchmarks de toupperd.
+//
+// Escribe en <directorio> archivos de texto llamados f0000000, f0000001, ...
+// con tamaños según una distribución y una mezcla de palabras ASCII y UTF-8.
+// Con la misma semilla y los mismos parámetros, el corpus es idéntico byte a
+// byte en cualquier máquina: los resultados de distintas versiones se comparan
+// contra los mismos datos.
+//
+// Uso: corpus [-n archivos] [-t tamaño_medio] [-d fija|uniforme|lognormal]
+//             [-u fracción_utf8] [-s semilla] <directorio>
+// Por defecto: 10000 archivos de 4096 bytes fijos, 20% de palabras UTF-8,
+// semilla 1.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TAMANO_MAXIMO (64L * 1024 * 1024) // Tope de la cola de la lognormal
+#define SIGMA_LOGNORMAL 1.0
+
+typedef enum {
+    DIST_FIJA,
+    DIST_UNIFORME,
+    DIST_LOGNORMAL,
+} Distribucion;
+
+static const char *nombres_distribucion[] = { "fija", "uniforme", "lognormal" };
+
+// Palabras ASCII y UTF-8 (español, griego, cirílico) para armar el texto
+static const char *palabras_ascii[] = {
+    "el", "la", "de", "que", "y", "en", "un", "los", "se", "del", "las", "por",
+    "archivo", "servicio", "texto", "carpeta", "destino", "origen", "proceso",
+    "consumidor", "productor", "buffer", "hilo", "fragmento", "mayusculas",
+};
+
+static const char *palabras_utf8[] = {
+    "año", "niño", "canción", "corazón", "pingüino", "acción", "está", "más",
+    "después", "también", "último", "señal", "búsqueda", "árbol", "ñandú",
+    "λόγος", "αλφάβητο", "кириллица", "привет", "über", "élève", "façade",
+};
+
+#define CANTIDAD(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+// xorshift64*: rápido y con la misma secuencia en cualquier plataforma
+static unsigned long long estado_rng;
+
+static unsigned long long aleatorio(void) {
+    estado_rng ^= estado_rng >> 12;
+    estado_rng ^= estado_rng << 25;
+    estado_rng ^= estado_rng >> 27;
+    return estado_rng * 0x2545f4914f6cdd1dULL;
+}
+
+// Uniforme en (0, 1)
+static double aleatorio_real(void) {
+    return ((aleatorio() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static long elegir_tamano(Distribucion d, long medio) {
+    long tamano;
+    switch (d) {
+    case DIST_UNIFORME:
+        tamano = 1 + (long) (aleatorio() % (unsigned long long) (2 * medio));
+        break;
+    case DIST_LOGNORMAL: {
+        // Box-Muller; mu elegido para que la media sea `medio`
+        double normal = sqrt(-2.0 * log(aleatorio_real())) * cos(2.0 * M_PI * aleatorio_real());
+        double mu = log((double) medio) - SIGMA_LOGNORMAL * SIGMA_LOGNORMAL / 2.0;
+        tamano = (long) exp(mu + SIGMA_LOGNORMAL * normal);
+        break;
+    }
+    default:
+        tamano = medio;
+        break;
+    }
+    if (tamano < 1) {
+        tamano = 1;
+    }
+    return tamano > TAMANO_MAXIMO ? TAMANO_MAXIMO : tamano;
+}
+
+// Llena `texto` con palabras separadas por espacios y saltos de línea. Una
+// palabra que no entra entera se reemplaza por espacios, así nunca queda un
+// carácter UTF-8 cortado al final.
+static void llenar_texto(char *texto, long tamano, double fraccion_utf8) {
+    long i = 0;
+    int en_linea = 0;
+    while (i < tamano) {
+        const char *palabra = aleatorio_real() < fraccion_utf8
+            ? palabras_utf8[aleatorio() % CANTIDAD(palabras_utf8)]
+            : palabras_ascii[aleatorio() % CANTIDAD(palabras_ascii)];
+        long largo = strlen(palabra);
+        if (i + largo + 1 > tamano) {
+            memset(texto + i, ' ', tamano - i);
+            break;
+        }
+        memcpy(texto + i, palabra, largo);
+        i += largo;
+        en_linea += largo + 1;
+        texto[i++] = en_linea > 72 ? '\n' : ' ';
+        if (en_linea > 72) {
+            en_linea = 0;
+        }
+    }
+}
+
+static void print_usage(void) {
+    fprintf(stderr, "Uso: corpus [-n archivos] [-t tamaño_medio] [-d fija|uniforme|lognormal]\n");
+    fprintf(stderr, "            [-u fracción_utf8] [-s semilla] <directorio>\n");
+}
+
+int main(int argc, char *argv[]) {
+    long archivos = 10000;
+    long medio = 4096;
+    Distribucion distribucion = DIST_FIJA;
+    double fraccion_utf8 = 0.2;
+    unsigned long long semilla = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:d:u:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            archivos = atol(optarg);
+            break;
+        case 't':
+            medio = atol(optarg);
+            break;
+        case 'd':
+            for (distribucion = 0; distribucion < CANTIDAD(nombres_distribucion); distribucion++) {
+                if (strcmp(optarg, nombres_distribucion[distribucion]) == 0) {
+                    break;
+                }
+            }
+            if (distribucion == CANTIDAD(nombres_distribucion)) {
+                fprintf(stderr, "corpus: distribución desconocida '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'u':
+            fraccion_utf8 = atof(optarg);
+            break;
+        case 's':
+            semilla = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            print_usage();
+            return 1;
+        }
+    }
+    if (argc - optind != 1 || archivos <= 0 || medio <= 0 || fraccion_utf8 < 0 || fraccion_utf8 > 1) {
+        print_usage();
+        return 1;
+    }
+    const char *directorio = argv[optind];
+
+    // Una semilla 0 dejaría a xorshift en cero para siempre
+    estado_rng = semilla * 0x9e3779b97f4a7c15ULL + 1;
+
+    char *texto = malloc(TAMANO_MAXIMO);
+    if (texto == NULL) {
+        perror("corpus: Error reservando memoria");
+        return 1;
+    }
+
+    long long total = 0;
+    for (long n = 0; n < archivos; n++) {
+        long tamano = elegir_tamano(distribucion, medio);
+        llenar_texto(texto, tamano, fraccion_utf8);
+
+        char ruta[4096];
+        snprintf(ruta, sizeof(ruta), "%s/f%07ld", directorio, n);
+        int fd = open(ruta, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0 || write(fd, texto, tamano) != tamano || close(fd) != 0) {
+            fprintf(stderr, "corpus: Error escribiendo %s: %s\n", ruta, strerror(errno));
+            return 1;
+        }
+        total += tamano;
+    }
+    free(texto);
+
+    printf("corpus: %ld archivos, %lld bytes, distribución %s, %.0f%% UTF-8, semilla %llu\n",
+           archivos, total, nombres_distribucion[distribucion], fraccion_utf8 * 100, semilla);
+    return 0;
+}
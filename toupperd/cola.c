@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+#include "cola.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+int cola_iniciar(Cola *c, size_t capacidad) {
+    size_t n = 2;
+    while (n < capacidad) {
+        n *= 2;
+    }
+    c->celdas = malloc(n * sizeof(Celda));
+    if (c->celdas == NULL) {
+        return -1;
+    }
+    // La celda i está libre para el productor de la vuelta cero
+    for (size_t i = 0; i < n; i++) {
+        c->celdas[i].secuencia = i;
+        c->celdas[i].valor = NULL;
+    }
+    c->mascara = n - 1;
+    c->entrada = 0;
+    c->salida = 0;
+    return 0;
+}
+
+void cola_cerrar(Cola *c) {
+    free(c->celdas);
+    c->celdas = NULL;
+}
+
+int cola_poner(Cola *c, void *valor) {
+    unsigned long pos = __atomic_load_n(&c->entrada, __ATOMIC_RELAXED);
+    while (1) {
+        Celda *celda = &c->celdas[pos & c->mascara];
+        unsigned long secuencia = __atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE);
+        long diferencia = (long) (secuencia - pos);
+        if (diferencia == 0) {
+            // Libre: reservarla avanzando el índice
+            if (__atomic_compare_exchange_n(&c->entrada, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                celda->valor = valor;
+                // Publicar: lista para el consumidor de esta vuelta
+                __atomic_store_n(&celda->secuencia, pos + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+            // Otro productor la tomó; pos ya tiene el índice actual
+        } else if (diferencia < 0) {
+            // Todavía tiene el valor de la vuelta anterior: llena
+            return -1;
+        } else {
+            pos = __atomic_load_n(&c->entrada, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void *cola_sacar(Cola *c) {
+    unsigned long pos = __atomic_load_n(&c->salida, __ATOMIC_RELAXED);
+    while (1) {
+        Celda *celda = &c->celdas[pos & c->mascara];
+        unsigned long secuencia = __atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE);
+        long diferencia = (long) (secuencia - (pos + 1));
+        if (diferencia == 0) {
+            if (__atomic_compare_exchange_n(&c->salida, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                void *valor = celda->valor;
+                // Liberarla para el productor de la vuelta siguiente
+                __atomic_store_n(&celda->secuencia, pos + c->mascara + 1, __ATOMIC_RELEASE);
+                return valor;
+            }
+        } else if (diferencia < 0) {
+            // Todavía no se publicó nada en esta celda: vacía
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&c->salida, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t cola_ocupados(Cola *c) {
+    unsigned long salida = __atomic_load_n(&c->salida, __ATOMIC_RELAXED);
+    unsigned long entrada = __atomic_load_n(&c->entrada, __ATOMIC_RELAXED);
+    return entrada > salida ? entrada - salida : 0;
+}
+
+void futex_esperar(unsigned *direccion, unsigned valor) {
+    syscall(SYS_futex, direccion, FUTEX_WAIT_PRIVATE, valor, NULL, NULL, 0);
+}
+
+void futex_despertar(unsigned *direccion, int n) {
+    syscall(SYS_futex, direccion, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
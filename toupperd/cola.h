@@ -0,0 +1,48 @@
+#ifndef COLA_H
+#define COLA_H
+
+#include <stddef.h>
+
+// --- Cola acotada sin bloqueos ---
+// Anillo de punteros para varios productores y varios consumidores (el de
+// Dmitry Vyukov): cada celda lleva un número de secuencia que dice si está
+// libre para la vuelta actual del productor o lista para la del consumidor, así
+// que poner y sacar son un compare-and-swap sobre el índice y ningún hilo
+// espera a otro que quedó a mitad de una operación en otra celda.
+// Poner y sacar nunca se bloquean: quien necesite esperar lo hace con
+// futex_esperar()/futex_despertar() sobre un contador propio.
+
+typedef struct {
+    unsigned long secuencia;
+    void *valor;
+} Celda;
+
+typedef struct {
+    Celda *celdas;
+    unsigned long mascara;
+    // Cada índice en su propia línea de caché: productores y consumidores no
+    // se invalidan la línea del otro en cada operación
+    unsigned long entrada __attribute__((aligned(64)));
+    unsigned long salida __attribute__((aligned(64)));
+} Cola;
+
+// Reserva la cola para al menos `capacidad` punteros. Devuelve 0 o -1.
+int cola_iniciar(Cola *c, size_t capacidad);
+void cola_cerrar(Cola *c);
+
+// Devuelve 0, o -1 si la cola está llena.
+int cola_poner(Cola *c, void *valor);
+
+// Devuelve el puntero más antiguo, o NULL si la cola está vacía.
+void *cola_sacar(Cola *c);
+
+// Cantidad aproximada de punteros en la cola (para las métricas)
+size_t cola_ocupados(Cola *c);
+
+// Duerme mientras *direccion valga `valor` (o hasta una señal).
+void futex_esperar(unsigned *direccion, unsigned valor);
+
+// Despierta hasta `n` hilos dormidos en `direccion`.
+void futex_despertar(unsigned *direccion, int n);
+
+#endif
@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include "diario.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DIARIO_NOMBRE DIARIO_PREFIJO "diario"
+#define DIARIO_MAX (1024 * 1024) // Al superarlo, se vacía en la próxima compactación
+#define NOMBRE_MAX 512 // Nombres relativos, con subdirectorios
+#define REGISTRO_MAX (256 + NOMBRE_MAX)
+
+// Cada confirmación es una línea:
+//   C <temporal> <dev> <ino> <tamaño> <mtime_s> <mtime_ns> <largo> <nombre>
+// El temporal se guarda sin el directorio y el nombre con su largo, así puede
+// contener espacios. Una línea incompleta al final (caída a mitad de escritura)
+// se ignora: su grupo nunca llegó a renombrarse.
+
+int diario_misma_identidad(const struct stat *st, const Identidad *id) {
+    return st->st_dev == id->dev && st->st_ino == id->ino && st->st_size == id->size &&
+           st->st_mtim.tv_sec == id->mtime_s && st->st_mtim.tv_nsec == id->mtime_ns;
+}
+
+// Rehace una confirmación anotada
+static int rehacer(const char *origen, const char *destino, const char *temporal,
+                   const char *nombre, const Identidad *id) {
+    char ruta_temporal[1024], ruta_destino[1024], ruta_origen[1024];
+    snprintf(ruta_temporal, sizeof(ruta_temporal), "%s/%s", destino, temporal);
+    snprintf(ruta_destino, sizeof(ruta_destino), "%s/%s", destino, nombre);
+    snprintf(ruta_origen, sizeof(ruta_origen), "%s/%s", origen, nombre);
+
+    // 1. Renombrar el temporal, si la caída fue antes del renombre
+    int rehecha = 0;
+    if (rename(ruta_temporal, ruta_destino) == 0) {
+        rehecha = 1;
+    } else if (errno != ENOENT) {
+        fprintf(stderr, "Diario: Error al renombrar %s: %s\n", ruta_temporal, strerror(errno));
+        return 0;
+    }
+
+    // 2. Borrar el original, si todavía es el mismo archivo y el destino está
+    //    completo (la conversión no cambia el tamaño). Si el renombre había
+    //    fallado, el temporal ya no existe y el original se conserva.
+    struct stat st, st_destino;
+    if (stat(ruta_origen, &st) == 0 && diario_misma_identidad(&st, id) &&
+        stat(ruta_destino, &st_destino) == 0 && st_destino.st_size == id->size) {
+        if (unlink(ruta_origen) == 0) {
+            rehecha = 1;
+        }
+    }
+    return rehecha;
+}
+
+static int reproducir(Diario *d, const char *origen, const char *destino) {
+    struct stat st;
+    if (fstat(d->fd, &st) != 0) {
+        return -1;
+    }
+    char *contenido = malloc(st.st_size + 1);
+    if (contenido == NULL) {
+        return -1;
+    }
+    ssize_t leido = pread(d->fd, contenido, st.st_size, 0);
+    if (leido < 0) {
+        free(contenido);
+        return -1;
+    }
+    contenido[leido] = '\0';
+
+    int rehechas = 0;
+    char *p = contenido;
+    char *fin = contenido + leido;
+    while (p < fin) {
+        char temporal[NAME_MAX + 1];
+        unsigned long long dev, ino;
+        long long size;
+        Identidad id;
+        int largo, cabecera;
+
+        if (sscanf(p, "C %255s %llu %llu %lld %ld %ld %d %n", temporal, &dev, &ino, &size,
+                   &id.mtime_s, &id.mtime_ns, &largo, &cabecera) != 7 ||
+            largo <= 0 || largo > NOMBRE_MAX || p + cabecera + largo >= fin ||
+            p[cabecera + largo] != '\n') {
+            break; // Registro incompleto: el resto no llegó a disco
+        }
+        char nombre[NOMBRE_MAX + 1];
+        memcpy(nombre, p + cabecera, largo);
+        nombre[largo] = '\0';
+        id.dev = dev;
+        id.ino = ino;
+        id.size = size;
+
+        rehechas += rehacer(origen, destino, temporal, nombre, &id);
+        p += cabecera + largo + 1;
+    }
+
+    free(contenido);
+    return rehechas;
+}
+
+// Borra los temporales que quedaron sin confirmar: su original sigue en el
+// origen y se va a volver a procesar.
+static void borrar_huerfanos(const char *destino) {
+    DIR *dirp = opendir(destino);
+    if (dirp == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dirp)) != NULL) {
+        size_t largo = strlen(entry->d_name);
+        if (strncmp(entry->d_name, DIARIO_PREFIJO, strlen(DIARIO_PREFIJO)) == 0 &&
+            largo > strlen(DIARIO_PREFIJO) + 4 &&
+            strcmp(entry->d_name + largo - 4, ".tmp") == 0) {
+            unlinkat(dirfd(dirp), entry->d_name, 0);
+        }
+    }
+    closedir(dirp);
+}
+
+// Destino y origen a disco; pueden estar en sistemas de archivos distintos
+static int sincronizar_todo(Diario *d) {
+    return syncfs(d->fd) != 0 || syncfs(d->fd_origen) != 0 ? -1 : 0;
+}
+
+int diario_abrir(Diario *d, const char *origen, const char *destino) {
+    char ruta[1024];
+    snprintf(ruta, sizeof(ruta), "%s/%s", destino, DIARIO_NOMBRE);
+
+    d->escrito = 0;
+    d->fd_origen = open(origen, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (d->fd_origen < 0) {
+        return -1;
+    }
+    d->fd = open(ruta, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (d->fd < 0) {
+        int e = errno;
+        close(d->fd_origen);
+        errno = e;
+        return -1;
+    }
+
+    int rehechas = reproducir(d, origen, destino);
+    borrar_huerfanos(destino);
+
+    // Lo rehecho (renombres en el destino, borrados en el origen) tiene que
+    // estar en disco antes de olvidarlo
+    if (rehechas < 0 || sincronizar_todo(d) != 0 || ftruncate(d->fd, 0) != 0 || fsync(d->fd) != 0) {
+        int e = errno;
+        close(d->fd);
+        close(d->fd_origen);
+        d->fd = d->fd_origen = -1;
+        errno = e;
+        return -1;
+    }
+    return rehechas;
+}
+
+int diario_sincronizar_datos(Diario *d) {
+    return syncfs(d->fd);
+}
+
+int diario_anotar(Diario *d, const Confirmacion *confirmaciones, int n) {
+    char *registros = malloc((size_t) n * REGISTRO_MAX);
+    if (registros == NULL) {
+        return -1;
+    }
+
+    size_t largo = 0;
+    for (int i = 0; i < n; i++) {
+        const Confirmacion *c = &confirmaciones[i];
+        const char *temporal = strrchr(c->temporal, '/');
+        temporal = temporal != NULL ? temporal + 1 : c->temporal;
+        largo += snprintf(registros + largo, REGISTRO_MAX, "C %s %llu %llu %lld %ld %ld %zu %s\n",
+                          temporal, (unsigned long long) c->origen.dev,
+                          (unsigned long long) c->origen.ino, (long long) c->origen.size,
+                          c->origen.mtime_s, c->origen.mtime_ns, strlen(c->nombre), c->nombre);
+    }
+
+    // Una sola escritura por grupo; con O_APPEND nunca se pisan registros
+    int error = 0;
+    for (size_t hecho = 0; hecho < largo; ) {
+        ssize_t w = write(d->fd, registros + hecho, largo - hecho);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = 1;
+            break;
+        }
+        hecho += w;
+    }
+    free(registros);
+
+    if (error || fdatasync(d->fd) != 0) {
+        // No dejar un registro a medias delante de los del próximo grupo
+        if (ftruncate(d->fd, d->escrito) != 0) {
+            fprintf(stderr, "Diario: Error al descartar un grupo incompleto: %s\n", strerror(errno));
+        }
+        return -1;
+    }
+    d->escrito += largo;
+    return 0;
+}
+
+void diario_compactar(Diario *d) {
+    if (d->escrito <= DIARIO_MAX) {
+        return;
+    }
+    // Un renombre o un borrado emitido puede no estar en disco todavía: sin
+    // el diario, una caída perdería el archivo en el origen y en el destino
+    if (sincronizar_todo(d) != 0) {
+        fprintf(stderr, "Diario: No se compacta, error al sincronizar: %s\n", strerror(errno));
+        return;
+    }
+    if (ftruncate(d->fd, 0) == 0) {
+        d->escrito = 0;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DIARIO_H
+#define DIARIO_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// --- Diario de confirmaciones ---
+// Archivo de sólo agregado (<destino>/.toupperd.diario) donde se anota, antes de
+// renombrar cada temporal, que sus datos ya están en disco y qué original hay que
+// borrar. Si el servicio se cae entre el renombre y el borrado, al arrancar se
+// rehace lo anotado en lugar de volver a procesar el archivo.
+// Hay un diario por carpeta de destino, y cada uno lo usa un único hilo.
+//
+// El diario y los temporales (<destino>/.toupperd.<n>.tmp) comparten carpeta
+// con los archivos convertidos: los nombres que empiezan con DIARIO_PREFIJO
+// son del servicio, y los archivos del origen con ese prefijo no se procesan
+// (pisarían el diario o se borrarían como temporales huérfanos).
+#define DIARIO_PREFIJO ".toupperd."
+
+// Identidad de un archivo de origen: si al reproducir el diario el original ya
+// no coincide, es otro archivo con el mismo nombre y no se toca.
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    long mtime_s;
+    long mtime_ns;
+} Identidad;
+
+// Si `st` (de stat()) es el mismo archivo que `id`
+int diario_misma_identidad(const struct stat *st, const Identidad *id);
+
+// Un temporal listo para pasar a <destino>/<nombre>
+typedef struct {
+    const char *temporal; // Ruta completa del temporal
+    const char *nombre;   // Relativo al origen y al destino
+    Identidad origen;
+} Confirmacion;
+
+typedef struct {
+    int fd;
+    int fd_origen; // Carpeta de origen, para pasar a disco los borrados
+    long escrito;  // Bytes anotados desde la última compactación
+} Diario;
+
+// Abre el diario en `destino` y lo reproduce: renombra los temporales anotados
+// que quedaron sin renombrar, borra los originales que siguen coincidiendo,
+// elimina los temporales huérfanos y deja el diario vacío. Devuelve la
+// cantidad de confirmaciones rehechas, o -1 si no se pudo abrir (con errno).
+int diario_abrir(Diario *d, const char *origen, const char *destino);
+
+// Pasa a disco los datos de todos los temporales del destino (un syncfs()).
+int diario_sincronizar_datos(Diario *d);
+
+// Anota un grupo de confirmaciones con una sola escritura y un fdatasync().
+// Recién cuando devuelve 0 los temporales pueden renombrarse.
+int diario_anotar(Diario *d, const Confirmacion *confirmaciones, int n);
+
+// Vacía el diario si creció demasiado. Sólo puede llamarse cuando todas las
+// confirmaciones anotadas ya se renombraron y sus originales se borraron:
+// antes de vaciarlo pasa a disco el destino y el origen (un syncfs() de cada
+// uno), y si eso falla lo deja como está.
+void diario_compactar(Diario *d);
+
+#endif
@@ -0,0 +1,121 @@
+#include "indice.h"
+
+#include <stdlib.h>
+
+// La tabla crece al duplicarse cuando pasa de la mitad de ocupación: con sondeo
+// lineal, las búsquedas siguen tocando una o dos líneas de caché.
+#define CARGA_MAX_NUM 1
+#define CARGA_MAX_DEN 2
+
+// Mezcla final de splitmix64: cambia la mitad de los bits por cada bit de entrada
+static unsigned long mezclar(unsigned long x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9UL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+    return x;
+}
+
+static unsigned long hash_identidad(const Identidad *id) {
+    unsigned long h = mezclar((unsigned long) id->ino);
+    h = mezclar(h ^ (unsigned long) id->dev);
+    h = mezclar(h ^ (unsigned long) id->size);
+    h = mezclar(h ^ ((unsigned long) id->mtime_s * 1000000000UL + (unsigned long) id->mtime_ns));
+    return h;
+}
+
+static int identidad_igual(const Identidad *a, const Identidad *b) {
+    return a->ino == b->ino && a->dev == b->dev && a->size == b->size &&
+           a->mtime_s == b->mtime_s && a->mtime_ns == b->mtime_ns;
+}
+
+int indice_iniciar(Indice *ix, size_t capacidad) {
+    size_t c = 16;
+    while (c * CARGA_MAX_NUM / CARGA_MAX_DEN < capacidad) {
+        c *= 2;
+    }
+    ix->ranuras = calloc(c, sizeof(Ranura));
+    ix->capacidad = c;
+    ix->n = 0;
+    return ix->ranuras != NULL ? 0 : -1;
+}
+
+void indice_cerrar(Indice *ix) {
+    free(ix->ranuras);
+    ix->ranuras = NULL;
+    ix->capacidad = ix->n = 0;
+}
+
+static int crecer(Indice *ix) {
+    size_t capacidad = ix->capacidad * 2;
+    Ranura *ranuras = calloc(capacidad, sizeof(Ranura));
+    if (ranuras == NULL) {
+        return -1;
+    }
+
+    // El hash está guardado en la ranura: no hace falta tocar las claves
+    for (size_t i = 0; i < ix->capacidad; i++) {
+        if (ix->ranuras[i].clave == NULL) {
+            continue;
+        }
+        size_t j = ix->ranuras[i].hash & (capacidad - 1);
+        while (ranuras[j].clave != NULL) {
+            j = (j + 1) & (capacidad - 1);
+        }
+        ranuras[j] = ix->ranuras[i];
+    }
+
+    free(ix->ranuras);
+    ix->ranuras = ranuras;
+    ix->capacidad = capacidad;
+    return 0;
+}
+
+int indice_agregar(Indice *ix, const Identidad *clave) {
+    if ((ix->n + 1) * CARGA_MAX_DEN > ix->capacidad * CARGA_MAX_NUM && crecer(ix) != 0 &&
+        ix->n + 1 >= ix->capacidad) {
+        // Sin memoria para crecer y sin lugar libre
+        return -1;
+    }
+
+    unsigned long h = hash_identidad(clave);
+    size_t mascara = ix->capacidad - 1;
+    size_t i = h & mascara;
+    while (ix->ranuras[i].clave != NULL) {
+        if (ix->ranuras[i].hash == h && identidad_igual(ix->ranuras[i].clave, clave)) {
+            return 0;
+        }
+        i = (i + 1) & mascara;
+    }
+
+    ix->ranuras[i] = (Ranura) { .hash = h, .clave = clave };
+    ix->n++;
+    return 1;
+}
+
+void indice_quitar(Indice *ix, const Identidad *clave) {
+    size_t mascara = ix->capacidad - 1;
+    size_t i = hash_identidad(clave) & mascara;
+    while (ix->ranuras[i].clave != clave) {
+        if (ix->ranuras[i].clave == NULL) {
+            return; // No estaba
+        }
+        i = (i + 1) & mascara;
+    }
+
+    // Borrado por desplazamiento hacia atrás: se corren las claves que quedarían
+    // inalcanzables, así la tabla nunca acumula marcas de borrado.
+    size_t hueco = i;
+    for (size_t j = (i + 1) & mascara; ix->ranuras[j].clave != NULL; j = (j + 1) & mascara) {
+        size_t ideal = ix->ranuras[j].hash & mascara;
+        // La clave en j puede ocupar el hueco si su posición ideal no está
+        // entre el hueco (exclusivo) y j (inclusivo), en orden circular
+        if (((j - ideal) & mascara) >= ((j - hueco) & mascara)) {
+            ix->ranuras[hueco] = ix->ranuras[j];
+            hueco = j;
+        }
+    }
+    ix->ranuras[hueco] = (Ranura) { 0 };
+    ix->n--;
+}
@@ -0,0 +1,39 @@
+#ifndef INDICE_H
+#define INDICE_H
+
+#include <stddef.h>
+
+#include "diario.h"
+
+// --- Índice de archivos en curso ---
+// Tabla hash de direccionamiento abierto (sondeo lineal) indexada por la
+// Identidad de cada archivo: dispositivo, inodo, tamaño y fecha de modificación.
+// Cada ranura guarda el hash y un puntero a la Identidad, que vive dentro del
+// trabajo; así una ranura ocupa 16 bytes y la tabla puede crecer a millones de
+// archivos sin volver a leer las claves al redimensionarse.
+// No es thread-safe: quien la usa la protege con su propio mutex.
+
+typedef struct {
+    unsigned long hash;
+    const Identidad *clave; // NULL: ranura libre
+} Ranura;
+
+typedef struct {
+    Ranura *ranuras;
+    size_t capacidad; // Siempre potencia de 2
+    size_t n;
+} Indice;
+
+// Reserva la tabla para al menos `capacidad` claves. Devuelve 0 o -1.
+int indice_iniciar(Indice *ix, size_t capacidad);
+void indice_cerrar(Indice *ix);
+
+// Agrega la clave si no hay otra igual. Devuelve 1 si la agregó, 0 si ya había
+// una igual, o -1 si no hubo memoria para crecer.
+int indice_agregar(Indice *ix, const Identidad *clave);
+
+// Quita exactamente esta clave (se compara el puntero, no el contenido, así un
+// duplicado descartado nunca quita la entrada del original).
+void indice_quitar(Indice *ix, const Identidad *clave);
+
+#endif
@@ -0,0 +1,510 @@
+#include "mayus.h"
+
+#include <immintrin.h>
+
+// --- Tabla de mayúsculas de Unicode ---
+// Mapeo simple a mayúsculas (UnicodeData.txt, Unicode 14) restringido a los
+// casos en que la mayúscula ocupa en UTF-8 los mismos bytes que la minúscula,
+// así la conversión se hace en el lugar. Quedan afuera, por ejemplo, ß (que
+// sería "SS"), ı -> I y ſ -> S; esos caracteres se dejan como están.
+// Cada rango mapea desde..hasta, de a `paso` (1, o 2 cuando minúsculas y
+// mayúsculas se alternan), al código + delta.
+typedef struct {
+    unsigned desde;
+    unsigned hasta;
+    int delta;
+    unsigned paso;
+} RangoMayus;
+
+static const RangoMayus rangos[] = {
+    { 0x00B5, 0x00B5, 743, 1 },
+    { 0x00E0, 0x00F6, -32, 1 },
+    { 0x00F8, 0x00FE, -32, 1 },
+    { 0x00FF, 0x00FF, 121, 1 },
+    { 0x0101, 0x012F, -1, 2 },
+    { 0x0133, 0x0137, -1, 2 },
+    { 0x013A, 0x0148, -1, 2 },
+    { 0x014B, 0x0177, -1, 2 },
+    { 0x017A, 0x017E, -1, 2 },
+    { 0x0180, 0x0180, 195, 1 },
+    { 0x0183, 0x0185, -1, 2 },
+    { 0x0188, 0x0188, -1, 1 },
+    { 0x018C, 0x018C, -1, 1 },
+    { 0x0192, 0x0192, -1, 1 },
+    { 0x0195, 0x0195, 97, 1 },
+    { 0x0199, 0x0199, -1, 1 },
+    { 0x019A, 0x019A, 163, 1 },
+    { 0x019E, 0x019E, 130, 1 },
+    { 0x01A1, 0x01A5, -1, 2 },
+    { 0x01A8, 0x01A8, -1, 1 },
+    { 0x01AD, 0x01AD, -1, 1 },
+    { 0x01B0, 0x01B0, -1, 1 },
+    { 0x01B4, 0x01B6, -1, 2 },
+    { 0x01B9, 0x01B9, -1, 1 },
+    { 0x01BD, 0x01BD, -1, 1 },
+    { 0x01BF, 0x01BF, 56, 1 },
+    { 0x01C5, 0x01C5, -1, 1 },
+    { 0x01C6, 0x01C6, -2, 1 },
+    { 0x01C8, 0x01C8, -1, 1 },
+    { 0x01C9, 0x01C9, -2, 1 },
+    { 0x01CB, 0x01CB, -1, 1 },
+    { 0x01CC, 0x01CC, -2, 1 },
+    { 0x01CE, 0x01DC, -1, 2 },
+    { 0x01DD, 0x01DD, -79, 1 },
+    { 0x01DF, 0x01EF, -1, 2 },
+    { 0x01F2, 0x01F2, -1, 1 },
+    { 0x01F3, 0x01F3, -2, 1 },
+    { 0x01F5, 0x01F5, -1, 1 },
+    { 0x01F9, 0x021F, -1, 2 },
+    { 0x0223, 0x0233, -1, 2 },
+    { 0x023C, 0x023C, -1, 1 },
+    { 0x0242, 0x0242, -1, 1 },
+    { 0x0247, 0x024F, -1, 2 },
+    { 0x0253, 0x0253, -210, 1 },
+    { 0x0254, 0x0254, -206, 1 },
+    { 0x0256, 0x0257, -205, 1 },
+    { 0x0259, 0x0259, -202, 1 },
+    { 0x025B, 0x025B, -203, 1 },
+    { 0x0260, 0x0260, -205, 1 },
+    { 0x0263, 0x0263, -207, 1 },
+    { 0x0268, 0x0268, -209, 1 },
+    { 0x0269, 0x0269, -211, 1 },
+    { 0x026F, 0x026F, -211, 1 },
+    { 0x0272, 0x0272, -213, 1 },
+    { 0x0275, 0x0275, -214, 1 },
+    { 0x0280, 0x0280, -218, 1 },
+    { 0x0283, 0x0283, -218, 1 },
+    { 0x0288, 0x0288, -218, 1 },
+    { 0x0289, 0x0289, -69, 1 },
+    { 0x028A, 0x028B, -217, 1 },
+    { 0x028C, 0x028C, -71, 1 },
+    { 0x0292, 0x0292, -219, 1 },
+    { 0x0345, 0x0345, 84, 1 },
+    { 0x0371, 0x0373, -1, 2 },
+    { 0x0377, 0x0377, -1, 1 },
+    { 0x037B, 0x037D, 130, 1 },
+    { 0x03AC, 0x03AC, -38, 1 },
+    { 0x03AD, 0x03AF, -37, 1 },
+    { 0x03B1, 0x03C1, -32, 1 },
+    { 0x03C2, 0x03C2, -31, 1 },
+    { 0x03C3, 0x03CB, -32, 1 },
+    { 0x03CC, 0x03CC, -64, 1 },
+    { 0x03CD, 0x03CE, -63, 1 },
+    { 0x03D0, 0x03D0, -62, 1 },
+    { 0x03D1, 0x03D1, -57, 1 },
+    { 0x03D5, 0x03D5, -47, 1 },
+    { 0x03D6, 0x03D6, -54, 1 },
+    { 0x03D7, 0x03D7, -8, 1 },
+    { 0x03D9, 0x03EF, -1, 2 },
+    { 0x03F0, 0x03F0, -86, 1 },
+    { 0x03F1, 0x03F1, -80, 1 },
+    { 0x03F2, 0x03F2, 7, 1 },
+    { 0x03F3, 0x03F3, -116, 1 },
+    { 0x03F5, 0x03F5, -96, 1 },
+    { 0x03F8, 0x03F8, -1, 1 },
+    { 0x03FB, 0x03FB, -1, 1 },
+    { 0x0430, 0x044F, -32, 1 },
+    { 0x0450, 0x045F, -80, 1 },
+    { 0x0461, 0x0481, -1, 2 },
+    { 0x048B, 0x04BF, -1, 2 },
+    { 0x04C2, 0x04CE, -1, 2 },
+    { 0x04CF, 0x04CF, -15, 1 },
+    { 0x04D1, 0x052F, -1, 2 },
+    { 0x0561, 0x0586, -48, 1 },
+    { 0x10D0, 0x10FA, 3008, 1 },
+    { 0x10FD, 0x10FF, 3008, 1 },
+    { 0x13F8, 0x13FD, -8, 1 },
+    { 0x1C88, 0x1C88, 35266, 1 },
+    { 0x1D79, 0x1D79, 35332, 1 },
+    { 0x1D7D, 0x1D7D, 3814, 1 },
+    { 0x1D8E, 0x1D8E, 35384, 1 },
+    { 0x1E01, 0x1E95, -1, 2 },
+    { 0x1E9B, 0x1E9B, -59, 1 },
+    { 0x1EA1, 0x1EFF, -1, 2 },
+    { 0x1F00, 0x1F07, 8, 1 },
+    { 0x1F10, 0x1F15, 8, 1 },
+    { 0x1F20, 0x1F27, 8, 1 },
+    { 0x1F30, 0x1F37, 8, 1 },
+    { 0x1F40, 0x1F45, 8, 1 },
+    { 0x1F51, 0x1F57, 8, 2 },
+    { 0x1F60, 0x1F67, 8, 1 },
+    { 0x1F70, 0x1F71, 74, 1 },
+    { 0x1F72, 0x1F75, 86, 1 },
+    { 0x1F76, 0x1F77, 100, 1 },
+    { 0x1F78, 0x1F79, 128, 1 },
+    { 0x1F7A, 0x1F7B, 112, 1 },
+    { 0x1F7C, 0x1F7D, 126, 1 },
+    { 0x1FB0, 0x1FB1, 8, 1 },
+    { 0x1FD0, 0x1FD1, 8, 1 },
+    { 0x1FE0, 0x1FE1, 8, 1 },
+    { 0x1FE5, 0x1FE5, 7, 1 },
+    { 0x214E, 0x214E, -28, 1 },
+    { 0x2170, 0x217F, -16, 1 },
+    { 0x2184, 0x2184, -1, 1 },
+    { 0x24D0, 0x24E9, -26, 1 },
+    { 0x2C30, 0x2C5F, -48, 1 },
+    { 0x2C61, 0x2C61, -1, 1 },
+    { 0x2C68, 0x2C6C, -1, 2 },
+    { 0x2C73, 0x2C73, -1, 1 },
+    { 0x2C76, 0x2C76, -1, 1 },
+    { 0x2C81, 0x2CE3, -1, 2 },
+    { 0x2CEC, 0x2CEE, -1, 2 },
+    { 0x2CF3, 0x2CF3, -1, 1 },
+    { 0x2D00, 0x2D25, -7264, 1 },
+    { 0x2D27, 0x2D27, -7264, 1 },
+    { 0x2D2D, 0x2D2D, -7264, 1 },
+    { 0xA641, 0xA66D, -1, 2 },
+    { 0xA681, 0xA69B, -1, 2 },
+    { 0xA723, 0xA72F, -1, 2 },
+    { 0xA733, 0xA76F, -1, 2 },
+    { 0xA77A, 0xA77C, -1, 2 },
+    { 0xA77F, 0xA787, -1, 2 },
+    { 0xA78C, 0xA78C, -1, 1 },
+    { 0xA791, 0xA793, -1, 2 },
+    { 0xA794, 0xA794, 48, 1 },
+    { 0xA797, 0xA7A9, -1, 2 },
+    { 0xA7B5, 0xA7C3, -1, 2 },
+    { 0xA7C8, 0xA7CA, -1, 2 },
+    { 0xA7D1, 0xA7D1, -1, 1 },
+    { 0xA7D7, 0xA7D9, -1, 2 },
+    { 0xA7F6, 0xA7F6, -1, 1 },
+    { 0xAB53, 0xAB53, -928, 1 },
+    { 0xAB70, 0xABBF, -38864, 1 },
+    { 0xFF41, 0xFF5A, -32, 1 },
+    { 0x10428, 0x1044F, -40, 1 },
+    { 0x104D8, 0x104FB, -40, 1 },
+    { 0x10597, 0x105A1, -39, 1 },
+    { 0x105A3, 0x105B1, -39, 1 },
+    { 0x105B3, 0x105B9, -39, 1 },
+    { 0x105BB, 0x105BC, -39, 1 },
+    { 0x10CC0, 0x10CF2, -64, 1 },
+    { 0x118C0, 0x118DF, -32, 1 },
+    { 0x16E60, 0x16E7F, -32, 1 },
+    { 0x1E922, 0x1E943, -34, 1 },
+};
+
+#define RANGOS (sizeof(rangos) / sizeof(rangos[0]))
+
+// Los caracteres de 2 bytes (U+0080..U+07FF) cubren el latín, el griego y el
+// cirílico: al iniciar se expanden en una tabla directa indexada por el código.
+// 0 indica que el carácter no cambia.
+static unsigned short tabla2[0x800 - 0x80];
+
+static void expandir_tabla(void) {
+    for (size_t r = 0; r < RANGOS && rangos[r].desde < 0x800; r++) {
+        for (unsigned cp = rangos[r].desde; cp <= rangos[r].hasta; cp += rangos[r].paso) {
+            tabla2[cp - 0x80] = cp + rangos[r].delta;
+        }
+    }
+}
+
+// Caracteres de 3 y 4 bytes: búsqueda binaria en los rangos
+static unsigned buscar(unsigned cp) {
+    size_t bajo = 0, alto = RANGOS;
+    while (bajo < alto) {
+        size_t medio = (bajo + alto) / 2;
+        if (rangos[medio].desde <= cp) {
+            bajo = medio + 1;
+        } else {
+            alto = medio;
+        }
+    }
+    if (bajo == 0) {
+        return cp;
+    }
+    const RangoMayus *r = &rangos[bajo - 1];
+    if (cp > r->hasta || (cp - r->desde) % r->paso != 0) {
+        return cp;
+    }
+    return cp + r->delta;
+}
+
+// Convierte una secuencia no ASCII que empieza en p y devuelve cuántos bytes
+// ocupa. Un byte que no empieza una secuencia válida, o una secuencia cortada
+// por el final del buffer, se deja como está y avanza uno.
+static size_t secuencia(char *p, size_t resto) {
+    const unsigned char *u = (const unsigned char *) p;
+    unsigned c0 = u[0];
+
+    if (c0 >= 0xC2 && c0 <= 0xDF) {
+        if (resto < 2 || (u[1] & 0xC0) != 0x80) {
+            return 1;
+        }
+        unsigned m = tabla2[(((c0 & 0x1F) << 6) | (u[1] & 0x3F)) - 0x80];
+        if (m != 0) {
+            p[0] = 0xC0 | (m >> 6);
+            p[1] = 0x80 | (m & 0x3F);
+        }
+        return 2;
+    }
+    if (c0 >= 0xE0 && c0 <= 0xEF) {
+        if (resto < 3 || (u[1] & 0xC0) != 0x80 || (u[2] & 0xC0) != 0x80) {
+            return 1;
+        }
+        unsigned cp = ((c0 & 0x0F) << 12) | ((u[1] & 0x3F) << 6) | (u[2] & 0x3F);
+        unsigned m = cp >= 0x800 ? buscar(cp) : cp; // Sin tocar codificaciones largas
+        if (m != cp) {
+            p[0] = 0xE0 | (m >> 12);
+            p[1] = 0x80 | ((m >> 6) & 0x3F);
+            p[2] = 0x80 | (m & 0x3F);
+        }
+        return 3;
+    }
+    if (c0 >= 0xF0 && c0 <= 0xF4) {
+        if (resto < 4 || (u[1] & 0xC0) != 0x80 || (u[2] & 0xC0) != 0x80 || (u[3] & 0xC0) != 0x80) {
+            return 1;
+        }
+        unsigned cp = ((c0 & 0x07) << 18) | ((u[1] & 0x3F) << 12) | ((u[2] & 0x3F) << 6) | (u[3] & 0x3F);
+        unsigned m = cp >= 0x10000 ? buscar(cp) : cp;
+        if (m != cp) {
+            p[0] = 0xF0 | (m >> 18);
+            p[1] = 0x80 | ((m >> 12) & 0x3F);
+            p[2] = 0x80 | ((m >> 6) & 0x3F);
+            p[3] = 0x80 | (m & 0x3F);
+        }
+        return 4;
+    }
+    return 1;
+}
+
+// Las variantes vectoriales convierten cada bloque como ASCII (los bytes >= 0x80
+// no están en 'a'..'z' y quedan intactos) y, sólo si el bloque tenía alguno,
+// pasan por la tabla las secuencias que empiezan ahí. `inicios` tiene un bit por
+// cada byte >= 0xC0 del bloque, los únicos que pueden empezar una secuencia (un
+// byte de continuación suelto se deja igual). Devuelve dónde sigue el
+// recorrido: el fin del bloque, o más allá si la última secuencia lo cruzaba.
+static size_t secuencias_bloque(char *buf, size_t n, size_t i, size_t ancho, unsigned long long inicios) {
+    size_t j = i;
+    while (inicios != 0) {
+        size_t k = i + __builtin_ctzll(inicios);
+        if (k >= j) {
+            j = k + secuencia(buf + k, n - k);
+        }
+        inicios &= inicios - 1;
+    }
+    return j > i + ancho ? j : i + ancho;
+}
+
+// --- Variante escalar ---
+// (c - 'a') < 26 sin signo equivale a 'a' <= c <= 'z'
+static void mayus_escalar(char *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = buf[i];
+        if ((unsigned char) (c - 'a') < 26) {
+            buf[i] = c - ('a' - 'A');
+        }
+    }
+}
+
+static void mayus_utf8_escalar(char *buf, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        unsigned char c = buf[i];
+        if (c < 0x80) {
+            if ((unsigned char) (c - 'a') < 26) {
+                buf[i] = c - ('a' - 'A');
+            }
+            i++;
+        } else {
+            i += secuencia(buf + i, n - i);
+        }
+    }
+}
+
+static int siempre(void) {
+    return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Las comparaciones SIMD de bytes son con signo: sumando 128 - 'a' el rango
+// 'a'..'z' queda en -128..-103 y basta un único "menor que -102".
+#define DESPLAZAMIENTO (128 - 'a')
+#define LIMITE (-128 + 26)
+
+__attribute__((target("sse2")))
+static void mayus_sse2(char *buf, size_t n) {
+    const __m128i desplazamiento = _mm_set1_epi8(DESPLAZAMIENTO);
+    const __m128i limite = _mm_set1_epi8(LIMITE);
+    const __m128i diferencia = _mm_set1_epi8('a' - 'A');
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+        __m128i es_minuscula = _mm_cmplt_epi8(_mm_add_epi8(v, desplazamiento), limite);
+        v = _mm_sub_epi8(v, _mm_and_si128(es_minuscula, diferencia));
+        _mm_storeu_si128((__m128i *) (buf + i), v);
+    }
+    mayus_escalar(buf + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mayus_utf8_sse2(char *buf, size_t n) {
+    const __m128i desplazamiento = _mm_set1_epi8(DESPLAZAMIENTO);
+    const __m128i limite = _mm_set1_epi8(LIMITE);
+    const __m128i diferencia = _mm_set1_epi8('a' - 'A');
+    const __m128i antes_de_c0 = _mm_set1_epi8((char) 0xBF);
+    size_t i = 0;
+
+    while (i + 16 <= n) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+        // Con signo, 0xC0..0xFF son los negativos mayores que 0xBF
+        unsigned inicios = _mm_movemask_epi8(_mm_and_si128(v, _mm_cmpgt_epi8(v, antes_de_c0)));
+        __m128i es_minuscula = _mm_cmplt_epi8(_mm_add_epi8(v, desplazamiento), limite);
+        v = _mm_sub_epi8(v, _mm_and_si128(es_minuscula, diferencia));
+        _mm_storeu_si128((__m128i *) (buf + i), v);
+        i = inicios == 0 ? i + 16 : secuencias_bloque(buf, n, i, 16, inicios);
+    }
+    mayus_utf8_escalar(buf + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mayus_avx2(char *buf, size_t n) {
+    const __m256i desplazamiento = _mm256_set1_epi8(DESPLAZAMIENTO);
+    const __m256i limite = _mm256_set1_epi8(LIMITE);
+    const __m256i diferencia = _mm256_set1_epi8('a' - 'A');
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+        __m256i es_minuscula = _mm256_cmpgt_epi8(limite, _mm256_add_epi8(v, desplazamiento));
+        v = _mm256_sub_epi8(v, _mm256_and_si256(es_minuscula, diferencia));
+        _mm256_storeu_si256((__m256i *) (buf + i), v);
+    }
+    mayus_sse2(buf + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mayus_utf8_avx2(char *buf, size_t n) {
+    const __m256i desplazamiento = _mm256_set1_epi8(DESPLAZAMIENTO);
+    const __m256i limite = _mm256_set1_epi8(LIMITE);
+    const __m256i diferencia = _mm256_set1_epi8('a' - 'A');
+    const __m256i antes_de_c0 = _mm256_set1_epi8((char) 0xBF);
+    size_t i = 0;
+
+    while (i + 32 <= n) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+        unsigned inicios = _mm256_movemask_epi8(_mm256_and_si256(v, _mm256_cmpgt_epi8(v, antes_de_c0)));
+        __m256i es_minuscula = _mm256_cmpgt_epi8(limite, _mm256_add_epi8(v, desplazamiento));
+        v = _mm256_sub_epi8(v, _mm256_and_si256(es_minuscula, diferencia));
+        _mm256_storeu_si256((__m256i *) (buf + i), v);
+        i = inicios == 0 ? i + 32 : secuencias_bloque(buf, n, i, 32, inicios);
+    }
+    mayus_utf8_sse2(buf + i, n - i);
+}
+
+// Con AVX-512BW las comparaciones sin signo y las máscaras permiten procesar
+// también la cola del buffer sin volver al código escalar.
+__attribute__((target("avx512f,avx512bw")))
+static void mayus_avx512bw(char *buf, size_t n) {
+    const __m512i a = _mm512_set1_epi8('a');
+    const __m512i letras = _mm512_set1_epi8(26);
+    const __m512i diferencia = _mm512_set1_epi8('a' - 'A');
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void *) (buf + i));
+        __mmask64 es_minuscula = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, a), letras);
+        v = _mm512_mask_sub_epi8(v, es_minuscula, v, diferencia);
+        _mm512_storeu_si512((void *) (buf + i), v);
+    }
+    if (i < n) {
+        __mmask64 cola = (1ULL << (n - i)) - 1; // n - i < 64
+        __m512i v = _mm512_maskz_loadu_epi8(cola, buf + i);
+        __mmask64 es_minuscula = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, a), letras);
+        v = _mm512_mask_sub_epi8(v, es_minuscula, v, diferencia);
+        _mm512_mask_storeu_epi8(buf + i, cola, v);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void mayus_utf8_avx512bw(char *buf, size_t n) {
+    const __m512i a = _mm512_set1_epi8('a');
+    const __m512i letras = _mm512_set1_epi8(26);
+    const __m512i diferencia = _mm512_set1_epi8('a' - 'A');
+    const __m512i c0 = _mm512_set1_epi8((char) 0xC0);
+    size_t i = 0;
+
+    while (i < n) {
+        // Bloques de 64 bytes; el último, enmascarado (los bytes de más se leen
+        // como 0 y no empiezan secuencias)
+        __mmask64 cola = n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+        __m512i v = _mm512_maskz_loadu_epi8(cola, buf + i);
+        __mmask64 inicios = _mm512_cmpge_epu8_mask(v, c0);
+        __mmask64 es_minuscula = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, a), letras);
+        v = _mm512_mask_sub_epi8(v, es_minuscula, v, diferencia);
+        _mm512_mask_storeu_epi8(buf + i, cola, v);
+        i = inicios == 0 ? i + 64 : secuencias_bloque(buf, n, i, 64, inicios);
+    }
+}
+
+static int tiene_sse2(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static int tiene_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int tiene_avx512bw(void) {
+    return __builtin_cpu_supports("avx512bw");
+}
+
+static const MayusVariante variantes[] = {
+    { "escalar", mayus_escalar, mayus_utf8_escalar, siempre },
+    { "sse2", mayus_sse2, mayus_utf8_sse2, tiene_sse2 },
+    { "avx2", mayus_avx2, mayus_utf8_avx2, tiene_avx2 },
+    { "avx512bw", mayus_avx512bw, mayus_utf8_avx512bw, tiene_avx512bw },
+};
+
+#else
+
+static const MayusVariante variantes[] = {
+    { "escalar", mayus_escalar, mayus_utf8_escalar, siempre },
+};
+
+#endif
+
+mayus_fn mayus = mayus_escalar;
+static int modo_utf8 = 0;
+
+const char *mayus_iniciar(int utf8) {
+    int elegida = 0;
+
+    expandir_tabla();
+    modo_utf8 = utf8;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+    for (int i = 0; i < (int) (sizeof(variantes) / sizeof(variantes[0])); i++) {
+        if (variantes[i].disponible()) {
+            elegida = i;
+        }
+    }
+    mayus = utf8 ? variantes[elegida].convertir_utf8 : variantes[elegida].convertir;
+    return variantes[elegida].nombre;
+}
+
+size_t mayus_corte(const char *buf, size_t n) {
+    if (!modo_utf8) {
+        return n;
+    }
+    // Buscar hacia atrás el comienzo de la última secuencia (a lo sumo 3 bytes)
+    for (size_t k = 1; k <= 3 && k <= n; k++) {
+        unsigned char c = buf[n - k];
+        if (c < 0x80) {
+            return n; // ASCII: no hay una secuencia abierta
+        }
+        if (c >= 0xC0) {
+            size_t largo = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+            return largo > k ? n - k : n;
+        }
+    }
+    return n;
+}
+
+const MayusVariante *mayus_variantes(int *cantidad) {
+    *cantidad = sizeof(variantes) / sizeof(variantes[0]);
+    return variantes;
+}
@@ -0,0 +1,40 @@
+#ifndef MAYUS_H
+#define MAYUS_H
+
+#include <stddef.h>
+
+// --- Núcleo de conversión a mayúsculas ---
+// Convierte en el lugar a mayúsculas, en uno de dos modos:
+//   - ASCII: las letras 'a'..'z' a 'A'..'Z', cualquier otro byte intacto (el
+//     mismo resultado que toupper() en la locale "C").
+//   - UTF-8: además, las letras no ASCII (á, ñ, ü, griego, cirílico, ...) según
+//     una tabla compacta de Unicode. Los bloques de puro ASCII van por el mismo
+//     camino vectorial que el modo ASCII; sólo las secuencias multibyte pasan
+//     por la tabla.
+// Hay una variante escalar y variantes SSE2, AVX2 y AVX-512BW; mayus_iniciar()
+// elige la mejor que soporte la CPU (vía cpuid).
+
+typedef void (*mayus_fn)(char *buf, size_t n);
+
+typedef struct {
+    const char *nombre;
+    mayus_fn convertir;       // Modo ASCII
+    mayus_fn convertir_utf8;  // Modo UTF-8
+    int (*disponible)(void);
+} MayusVariante;
+
+// Variante elegida por mayus_iniciar(); hasta entonces, la escalar
+extern mayus_fn mayus;
+
+// Elige la variante y el modo (utf8: 0 o 1) y devuelve el nombre de la variante
+const char *mayus_iniciar(int utf8);
+
+// En modo UTF-8, el largo más grande <= n que no corta una secuencia al final
+// de buf; en modo ASCII, n. Quien parte un archivo en fragmentos lo usa para que
+// ningún carácter quede repartido entre dos.
+size_t mayus_corte(const char *buf, size_t n);
+
+// Todas las variantes compiladas, de la más simple a la más ancha
+const MayusVariante *mayus_variantes(int *cantidad);
+
+#endif
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include "metricas.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// --- Histogramas ---
+// Valores de 0 a 15 ns van en cubetas exactas. Desde ahí, cada potencia de 2
+// [2^k, 2^(k+1)) se parte en SUBCUBETAS cubetas de igual ancho.
+#define SUBCUBETAS_BITS 3
+#define SUBCUBETAS (1 << SUBCUBETAS_BITS)
+#define LINEALES (2 * SUBCUBETAS)
+#define EXPONENTE_MIN (SUBCUBETAS_BITS + 1)
+#define EXPONENTE_MAX 40 // ~18 minutos; lo que exceda se cuenta en la última
+#define CUBETAS (LINEALES + (EXPONENTE_MAX - EXPONENTE_MIN + 1) * SUBCUBETAS)
+
+// Límites superiores exportados a Prometheus (le="..."), en potencias de 2 de ns
+#define LE_EXPONENTE_MIN 10 // ~1 us
+#define LE_EXPONENTE_MAX 35 // ~34 s
+
+typedef struct {
+    unsigned long cubetas[CUBETAS];
+    unsigned long cantidad;
+    unsigned long suma_ns;
+} Histograma;
+
+static Histograma histogramas[ETAPAS];
+static unsigned long contadores[CONTADORES];
+
+static const char *nombres_etapa[ETAPAS] = {
+    "descubrimiento", "cola", "conversion", "escritura", "confirmacion", "eliminacion",
+};
+
+static const struct {
+    const char *nombre;
+    const char *ayuda;
+} nombres_contador[CONTADORES] = {
+    { "toupperd_archivos_total", "Archivos guardados en destino." },
+    { "toupperd_errores_total", "Archivos que no se pudieron procesar." },
+    { "toupperd_bytes_total", "Bytes convertidos a mayusculas." },
+    { "toupperd_fragmentos_total", "Fragmentos que pasaron por el anillo." },
+    { "toupperd_sincronizaciones_total", "Sincronizaciones a disco de las confirmaciones en grupo." },
+};
+
+static int indice_cubeta(unsigned long v) {
+    if (v < LINEALES) {
+        return v;
+    }
+    int k = 63 - __builtin_clzl(v);
+    if (k > EXPONENTE_MAX) {
+        return CUBETAS - 1;
+    }
+    int sub = (v >> (k - SUBCUBETAS_BITS)) & (SUBCUBETAS - 1);
+    return LINEALES + (k - EXPONENTE_MIN) * SUBCUBETAS + sub;
+}
+
+// Límite superior (exclusivo) de la cubeta, en ns
+static unsigned long limite_cubeta(int i) {
+    if (i < LINEALES) {
+        return i + 1;
+    }
+    int k = (i - LINEALES) / SUBCUBETAS + EXPONENTE_MIN;
+    int sub = (i - LINEALES) % SUBCUBETAS;
+    return (unsigned long) (SUBCUBETAS + sub + 1) << (k - SUBCUBETAS_BITS);
+}
+
+long metricas_ahora(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void metricas_observar(Etapa etapa, long ns) {
+    Histograma *h = &histogramas[etapa];
+    unsigned long v = ns > 0 ? ns : 0;
+
+    __atomic_fetch_add(&h->cubetas[indice_cubeta(v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->cantidad, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->suma_ns, v, __ATOMIC_RELAXED);
+}
+
+void metricas_sumar(Contador contador, long n) {
+    __atomic_fetch_add(&contadores[contador], n, __ATOMIC_RELAXED);
+}
+
+// --- Exportación en formato de texto de Prometheus ---
+void metricas_etiqueta(FILE *salida, const char *valor) {
+    fputc('"', salida);
+    for (const char *p = valor; *p != '\0'; p++) {
+        if (*p == '\\' || *p == '"') {
+            fputc('\\', salida);
+            fputc(*p, salida);
+        } else if (*p == '\n') {
+            fputs("\\n", salida);
+        } else {
+            fputc(*p, salida);
+        }
+    }
+    fputc('"', salida);
+}
+
+static void exportar_histograma(FILE *salida, Etapa etapa, unsigned long *cubetas) {
+    const char *nombre = nombres_etapa[etapa];
+    unsigned long acumulado = 0, cantidad = 0;
+    int i = 0;
+
+    for (int j = 0; j < CUBETAS; j++) {
+        cantidad += cubetas[j];
+    }
+
+    for (int k = LE_EXPONENTE_MIN; k <= LE_EXPONENTE_MAX; k++) {
+        unsigned long le = 1UL << k;
+        while (i < CUBETAS && limite_cubeta(i) <= le) {
+            acumulado += cubetas[i++];
+        }
+        fprintf(salida, "toupperd_etapa_segundos_bucket{etapa=\"%s\",le=\"%.9g\"} %lu\n",
+                nombre, le / 1e9, acumulado);
+    }
+    fprintf(salida, "toupperd_etapa_segundos_bucket{etapa=\"%s\",le=\"+Inf\"} %lu\n", nombre, cantidad);
+    fprintf(salida, "toupperd_etapa_segundos_sum{etapa=\"%s\"} %.9f\n", nombre,
+            __atomic_load_n(&histogramas[etapa].suma_ns, __ATOMIC_RELAXED) / 1e9);
+    fprintf(salida, "toupperd_etapa_segundos_count{etapa=\"%s\"} %lu\n", nombre, cantidad);
+}
+
+static void exportar_percentiles(FILE *salida, Etapa etapa, unsigned long *cubetas) {
+    static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    unsigned long cantidad = 0;
+
+    for (int j = 0; j < CUBETAS; j++) {
+        cantidad += cubetas[j];
+    }
+    for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+        unsigned long objetivo = (unsigned long) (percentiles[p] * cantidad);
+        unsigned long acumulado = 0;
+        unsigned long valor = 0;
+        for (int j = 0; cantidad > 0 && j < CUBETAS; j++) {
+            acumulado += cubetas[j];
+            if (acumulado > objetivo) {
+                valor = limite_cubeta(j);
+                break;
+            }
+        }
+        fprintf(salida, "toupperd_etapa_percentil_segundos{etapa=\"%s\",percentil=\"%g\"} %.9g\n",
+                nombres_etapa[etapa], percentiles[p], valor / 1e9);
+    }
+}
+
+void metricas_exportar(FILE *salida, void (*medidores)(FILE *salida)) {
+    static pthread_mutex_t exportar_mutex = PTHREAD_MUTEX_INITIALIZER; // Protege fotos
+
+    pthread_mutex_lock(&exportar_mutex);
+    for (int c = 0; c < CONTADORES; c++) {
+        fprintf(salida, "# HELP %s %s\n", nombres_contador[c].nombre, nombres_contador[c].ayuda);
+        fprintf(salida, "# TYPE %s counter\n", nombres_contador[c].nombre);
+        fprintf(salida, "%s %lu\n", nombres_contador[c].nombre,
+                __atomic_load_n(&contadores[c], __ATOMIC_RELAXED));
+    }
+
+    // Foto de las cubetas: cada una se lee atómicamente, el conjunto puede
+    // mezclar observaciones de un instante y el siguiente (como Prometheus espera)
+    static unsigned long fotos[ETAPAS][CUBETAS];
+    for (int e = 0; e < ETAPAS; e++) {
+        for (int j = 0; j < CUBETAS; j++) {
+            fotos[e][j] = __atomic_load_n(&histogramas[e].cubetas[j], __ATOMIC_RELAXED);
+        }
+    }
+
+    fprintf(salida, "# HELP toupperd_etapa_segundos Latencia de cada etapa del procesamiento.\n");
+    fprintf(salida, "# TYPE toupperd_etapa_segundos histogram\n");
+    for (int e = 0; e < ETAPAS; e++) {
+        exportar_histograma(salida, e, fotos[e]);
+    }
+
+    fprintf(salida, "# HELP toupperd_etapa_percentil_segundos Percentiles de latencia por etapa (cota superior de la cubeta).\n");
+    fprintf(salida, "# TYPE toupperd_etapa_percentil_segundos gauge\n");
+    for (int e = 0; e < ETAPAS; e++) {
+        exportar_percentiles(salida, e, fotos[e]);
+    }
+
+    if (medidores != NULL) {
+        medidores(salida);
+    }
+    pthread_mutex_unlock(&exportar_mutex);
+}
+
+// --- Servidor HTTP mínimo ---
+#define METRICAS_ESPERA_S 2 // Para recibir el pedido y para enviar la respuesta
+
+typedef struct {
+    int fd;
+    void (*medidores)(FILE *salida);
+} Servidor;
+
+// Envía todo con MSG_NOSIGNAL: si el cliente cierra a mitad de la respuesta,
+// send() falla con EPIPE en lugar de matar el servicio con SIGPIPE
+static int enviar_todo(int fd, const char *datos, size_t largo) {
+    while (largo > 0) {
+        ssize_t n = send(fd, datos, largo, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        datos += n;
+        largo -= n;
+    }
+    return 0;
+}
+
+static void responder(int cliente, const char *cuerpo, size_t largo) {
+    char cabecera[256];
+    int n = snprintf(cabecera, sizeof(cabecera),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\n\r\n", largo);
+    if (enviar_todo(cliente, cabecera, n) == 0) {
+        enviar_todo(cliente, cuerpo, largo);
+    }
+}
+
+static void *hilo_metricas(void *arg) {
+    Servidor *servidor = arg;
+
+    while (1) {
+        int cliente = accept4(servidor->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (cliente < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("Métricas: Error aceptando conexión");
+            break;
+        }
+
+        // Hay un solo hilo: un cliente que no manda nada o no lee no puede
+        // retenerlo más que el plazo
+        struct timeval plazo = { .tv_sec = METRICAS_ESPERA_S };
+        setsockopt(cliente, SOL_SOCKET, SO_RCVTIMEO, &plazo, sizeof(plazo));
+        setsockopt(cliente, SOL_SOCKET, SO_SNDTIMEO, &plazo, sizeof(plazo));
+
+        // El pedido no importa: cualquier ruta devuelve las métricas
+        char pedido[1024];
+        if (read(cliente, pedido, sizeof(pedido)) < 0) {
+            close(cliente);
+            continue;
+        }
+
+        char *cuerpo = NULL;
+        size_t largo = 0;
+        FILE *memoria = open_memstream(&cuerpo, &largo);
+        if (memoria != NULL) {
+            metricas_exportar(memoria, servidor->medidores);
+            fclose(memoria);
+            responder(cliente, cuerpo, largo);
+            free(cuerpo);
+        }
+        close(cliente);
+    }
+
+    close(servidor->fd);
+    free(servidor);
+    return NULL;
+}
+
+int metricas_servir(const char *direccion, void (*medidores)(FILE *salida)) {
+    char *fin;
+    long puerto = strtol(direccion, &fin, 10);
+    int fd;
+
+    if (*direccion != '\0' && *fin == '\0') {
+        struct sockaddr_in dir = {
+            .sin_family = AF_INET,
+            .sin_port = htons(puerto),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        int uno = 1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &uno, sizeof(uno));
+        if (puerto <= 0 || puerto > 65535 || bind(fd, (struct sockaddr *) &dir, sizeof(dir)) != 0) {
+            int e = puerto <= 0 || puerto > 65535 ? EINVAL : errno;
+            close(fd);
+            errno = e;
+            return -1;
+        }
+    } else {
+        struct sockaddr_un dir = { .sun_family = AF_UNIX };
+        if (strlen(direccion) >= sizeof(dir.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(dir.sun_path, direccion);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        // Un socket viejo de una corrida anterior se reemplaza; cualquier otro
+        // archivo en esa ruta no es nuestro
+        struct stat st;
+        if (lstat(direccion, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                close(fd);
+                errno = EEXIST;
+                return -1;
+            }
+            unlink(direccion);
+        }
+        if (bind(fd, (struct sockaddr *) &dir, sizeof(dir)) != 0) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            return -1;
+        }
+    }
+
+    Servidor *servidor = malloc(sizeof(Servidor));
+    if (listen(fd, 16) != 0 || servidor == NULL) {
+        int e = servidor == NULL ? ENOMEM : errno;
+        close(fd);
+        free(servidor);
+        errno = e;
+        return -1;
+    }
+    servidor->fd = fd;
+    servidor->medidores = medidores;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, hilo_metricas, servidor) != 0) {
+        close(fd);
+        free(servidor);
+        errno = EAGAIN;
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stdio.h>
+
+// --- Métricas de toupperd ---
+// Contadores y un histograma de latencia por etapa, con la misma idea que
+// HdrHistogram: cubetas logarítmicas (potencias de 2) subdivididas en 8 partes
+// lineales, así el error relativo de cualquier percentil es menor al 12,5%.
+// Registrar una observación es un par de sumas atómicas, sin locks.
+// Se exponen en formato de texto de Prometheus por HTTP, en un socket Unix o
+// en un puerto TCP local.
+
+typedef enum {
+    ETAPA_DESCUBRIMIENTO, // Detección del archivo -> primer fragmento encolado
+    ETAPA_COLA,           // Encolado -> tomado por un consumidor
+    ETAPA_CONVERSION,     // Conversión a mayúsculas
+    ETAPA_ESCRITURA,      // Escritura en el temporal de destino
+    ETAPA_CONFIRMACION,   // Temporal cerrado -> datos y diario en disco
+    ETAPA_ELIMINACION,    // Renombre al destino y borrado del original
+    ETAPAS
+} Etapa;
+
+typedef enum {
+    CONTADOR_ARCHIVOS,    // Archivos guardados en destino
+    CONTADOR_ERRORES,     // Archivos que no se pudieron procesar
+    CONTADOR_BYTES,       // Bytes convertidos
+    CONTADOR_FRAGMENTOS,  // Fragmentos que pasaron por el anillo
+    CONTADOR_SINCRONIZACIONES, // syncfs()/fdatasync() de las confirmaciones
+    CONTADORES
+} Contador;
+
+// Reloj monotónico en nanosegundos
+long metricas_ahora(void);
+
+void metricas_observar(Etapa etapa, long ns);
+void metricas_sumar(Contador contador, long n);
+
+// Escribe todas las métricas en formato de texto de Prometheus. `medidores`
+// agrega los valores instantáneos (ocupación del anillo, etc.); puede ser NULL.
+void metricas_exportar(FILE *salida, void (*medidores)(FILE *salida));
+
+// Escribe `valor` como valor de una etiqueta, entre comillas y con \, " y los
+// saltos de línea escapados. Para los medidores con etiquetas.
+void metricas_etiqueta(FILE *salida, const char *valor);
+
+// Atiende pedidos HTTP en `direccion` desde un hilo propio: si es un número se
+// escucha en ese puerto de 127.0.0.1, si no se crea un socket Unix con esa
+// ruta (si la ruta ya existe, sólo se reemplaza un socket; cualquier otro
+// archivo da EEXIST). Devuelve 0, o -1 si no se pudo abrir (con errno).
+// Cada pedido tiene METRICAS_ESPERA_S segundos para llegar y para leer la
+// respuesta: un cliente lento o colgado no bloquea a los siguientes.
+int metricas_servir(const char *direccion, void (*medidores)(FILE *salida));
+
+#endif
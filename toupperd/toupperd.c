@@ -1,39 +1,235 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <dirent.h>
-#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "cola.h"
+#include "diario.h"
+#include "indice.h"
+#include "mayus.h"
+#include "metricas.h"
 
 // --- Definiciones del Buffer y Rutas ---
-#define BUFFER_SIZE 5
-#define FILE_MAX_SIZE (48 * 1024) // 48 KiB [cite: 60]
+#define CHUNK_SIZE (48 * 1024) // 48 KiB por fragmento [cite: 60]
+#define MAX_EN_VUELO_DEFECTO (64L * 1024 * 1024) // --max-inflight-bytes por defecto
+#define LIMITE_MIN (4L * CHUNK_SIZE) // Profundidad mínima de la cola de una fuente
+#define LIMITE_INICIAL (1024L * 1024) // Profundidad con la que arranca
+#define CARGO_MIN 4096 // Lo mínimo que una entrada descuenta del presupuesto
+#define ADAPTAR_NS 100000000L // Período de ajuste de la profundidad (100 ms)
+#define HORIZONTE_NS 50000000L // Trabajo encolado que vale la pena tener (50 ms)
+#define COLA_ENTRADAS_MAX (1 << 20)
+#define GRANDE_MIN_SIZE (256 * 1024) // Desde acá un archivo va al carril de grandes
+#define RONDA_GRANDES 4 // Cada cuántas entradas un consumidor prefiere el carril de grandes
+#define ESPERA_GRANDE_MAX_NS 2000000000L // Un grande que espera más pasa primero (2 s)
+#define MMAP_CHUNK_SIZE (1024 * 1024) // Fragmentos del motor mmap
+#define MMAP_MIN_SIZE (1024 * 1024) // Archivos más chicos van siempre por stdio
+#define EN_CURSO_INICIAL 65536 // Capacidad inicial del índice de archivos en curso
+#define CONFIRMAR_MAX 128 // Temporales por grupo de confirmación
+#define REINTENTO_MIN_NS 100000000L // Primera espera tras un grupo que no se pudo anotar (100 ms)
+#define REINTENTO_MAX_NS 30000000000L // Tope de la espera entre reintentos (30 s)
+#define POLL_INTERVAL 2 // Segundos entre escaneos cuando inotify no está disponible
+#define INOTIFY_BUF_SIZE (64 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+#define CARPETA_MAX 512 // Carpetas de origen y destino
+#define NOMBRE_MAX 512 // Nombres relativos al origen, con subdirectorios
+#define RUTA_MAX (CARPETA_MAX + NOMBRE_MAX + 32) // Rutas completas
+
+struct Fuente;
+
+// Carriles de cada fuente: los archivos chicos y los fragmentos de los grandes
+// van por colas separadas, así un archivo de varios GiB no deja detrás de sí a
+// los miles de archivos chicos que llegaron después.
+typedef enum {
+    CARRIL_CHICOS,
+    CARRIL_GRANDES,
+    CARRILES,
+} Carril;
 
-// Estructura para almacenar la información del archivo en el buffer
-typedef struct {
-    char filename[256];
-    char content[FILE_MAX_SIZE];
+// Un archivo en proceso. Sus fragmentos viajan por el buffer y cada consumidor
+// escribe el suyo en el temporal del destino con pwrite() en su desplazamiento,
+// así que varios consumidores pueden avanzar sobre el mismo archivo a la vez.
+// El último en soltar el trabajo lo pasa al confirmador, que lo renombra al
+// destino final.
+typedef struct Trabajo {
+    struct Fuente *fuente;
+    char filename[NOMBRE_MAX]; // Relativo al origen (y al destino)
+    char temporal[RUTA_MAX];   // Archivo temporal en destino
+    int fd_destino;
+    int pendientes;         // Fragmentos sin escribir, +1 mientras el productor lee
+    int error;
+    long bytes;             // Tamaño cargado, para las métricas
+    long descubierto_ns;    // Cuándo se detectó el archivo
+    long cerrado_ns;        // Cuándo se cerró el temporal
+    Identidad origen;       // Clave en el índice de en curso y, para el diario,
+                            // qué original borrar
+    int en_indice;          // Si origen está en el índice de su fuente
+    char *mapa_origen;      // Motor mmap: mapas de origen y destino
+    char *mapa_destino;
+    size_t largo_mapa;
+    Carril carril;          // Por dónde viajan sus fragmentos
+    int fd_origen;          // Archivo grande: abierto hasta que lo lea el lector
+    off_t largo;            // Archivo grande: tamaño según fstat()
+    pthread_mutex_t mutex;  // Protege pendientes y error
+    struct Trabajo *siguiente_grande;    // Pendientes del lector de grandes
+    struct Trabajo *siguiente_confirmar; // Cola del confirmador
+} Trabajo;
+
+// Una entrada de la cola: el descriptor de un fragmento y, con stdio, sus datos
+// a continuación, en un solo bloque de largo variable tomado del pool. Por la
+// cola sólo viaja el puntero, nunca los datos.
+typedef struct FileData {
+    struct Fuente *fuente;
+    Trabajo *trabajo;
+    long encolado_ns;
+    off_t offset;
+    const char *origen; // Motor mmap: datos en el mapa de origen (NULL con stdio)
+    char *content; // Los datos de la entrada, o el mapa de destino
     long size;
+    long cargo;    // Bytes descontados del presupuesto de la fuente
+    int clase;     // Clase del pool, según la capacidad de datos
+    Carril carril;
+    struct FileData *siguiente_libre;
+    char datos[];  // Con stdio, el contenido del fragmento
 } FileData;
 
+// Un par origen -> destino. Cada fuente tiene su propio escáner (el productor),
+// su cola acotada hacia los consumidores, su índice de archivos en curso y su
+// confirmador con su diario, así que una carpeta con mucha actividad no frena
+// a las demás ni comparten un mutex.
+typedef struct Fuente {
+    char origen[CARPETA_MAX];
+    char destino[CARPETA_MAX];
+    int recursivo;          // Reflejar también los subdirectorios
+
+    // Colas hacia los consumidores [cite: 57], una por carril. Su profundidad
+    // se mide en bytes: sólo se encola mientras las entradas de la fuente que
+    // todavía no se escribieron sumen menos que `limite`, y las del carril de
+    // grandes nunca más de la mitad.
+    Cola colas[CARRILES];
+    long en_vuelo;          // Bytes de entradas encoladas o en proceso
+    long en_vuelo_grandes;  // La parte de en_vuelo del carril de grandes
+    long limite;            // Profundidad actual, entre LIMITE_MIN y max_en_vuelo
+    long max_en_vuelo;      // La parte de --max-inflight-bytes de esta fuente
+    unsigned liberados;     // Futex: cambia cada vez que se devuelve presupuesto
+    int esperando;          // Productor y lector dormidos en `liberados`
+
+    // Ajuste de la profundidad según los ritmos observados
+    pthread_mutex_t ajuste_mutex; // Lo ajusta el primero que lo encuentra vencido
+    long periodo_ns;        // Inicio del período actual
+    long producidos;        // Bytes reservados por productor y lector en el período
+    long consumidos;        // Bytes devueltos por los consumidores en el período
+    int bloqueos;           // Veces que productor o lector esperaron presupuesto
+    unsigned long dormidas_vistas; // g_dormidas al empezar el período
+    long ritmo_entrada;     // Bytes/s del último período, para las métricas
+    long ritmo_salida;
+
+    // Archivos en curso
+    Indice en_curso;
+    pthread_mutex_t en_curso_mutex;
+
+    // Lector de grandes: archivos de GRANDE_MIN_SIZE o más que el productor ya
+    // abrió y dejó pendientes, en orden de llegada
+    Trabajo *grandes_primero;
+    Trabajo **grandes_ultimo;
+    int num_grandes;
+    pthread_mutex_t grandes_mutex;
+    pthread_cond_t grandes_cond;
+
+    // Productor
+    int inotify;            // -1 sin inotify
+    char **vigilados;       // Subdirectorio de cada vigilancia, por descriptor
+    int num_vigilados;
+
+    // Confirmador
+    Diario diario;
+    Trabajo *confirmar_primero; // Cola de temporales listos para confirmar
+    Trabajo **confirmar_ultimo;
+    pthread_mutex_t confirmar_mutex;
+    pthread_cond_t confirmar_cond;
+
+    pthread_t productor_tid;
+    pthread_t lector_tid;
+    pthread_t confirmador_tid;
+} Fuente;
+
+// Motores de E/S
+typedef enum {
+    MOTOR_STDIO,
+    MOTOR_MMAP,
+} Motor;
+
+static const char *nombres_motor[] = { "stdio", "mmap" };
+
 // --- Variables Globales Compartidas ---
-FileData shared_buffer[BUFFER_SIZE];
-int buffer_in = 0;
-int buffer_out = 0;
-char *g_origen_path;
-char *g_destino_path;
+Fuente *g_fuentes;
+int g_num_fuentes = 0;
+long g_max_en_vuelo = MAX_EN_VUELO_DEFECTO; // --max-inflight-bytes, entre todas las fuentes
+int g_num_consumidores = 0; // 0: uno por CPU en línea
+Motor g_motor = MOTOR_STDIO;
+unsigned long g_trabajos_creados = 0; // Para nombrar los temporales
+int g_verboso = 0; // -v: una línea por archivo en stdout
+
+// Mensajes por archivo: sólo con -v, con mucha carga son un costo en sí mismos
+#define VERBOSO(...) do { if (g_verboso) printf(__VA_ARGS__); } while (0)
 
 // --- Mecanismos de Sincronización [cite: 57] ---
-sem_t sem_full;  // Cuenta espacios llenos (inicial: 0)
-sem_t sem_empty; // Cuenta espacios vacíos (inicial: 5)
-pthread_mutex_t buffer_mutex; // Mutex para el acceso a buffer_in/out y al buffer
+// Las colas no usan locks (ver cola.c). Un consumidor sin trabajo en ninguna
+// cola duerme en el futex g_avisos, que cambia con cada entrada encolada; el
+// productor sólo hace la llamada al sistema si hay alguno dormido.
+unsigned g_avisos;
+int g_consumidores_dormidos;
+unsigned long g_dormidas; // Veces que un consumidor se durmió, para el ajuste
+
+// Pool de entradas: una pila de libres por clase de capacidad
+static const long clases_pool[] = { 0, 4096, 8192, 16384, 32768, CHUNK_SIZE };
+#define CLASES_POOL ((int) (sizeof(clases_pool) / sizeof(clases_pool[0])))
+FileData *pool_libres[CLASES_POOL];
+int pool_libres_n = 0;
+pthread_mutex_t pool_mutex; // Mutex para pool_libres
 
 // --- Documentación de Funcionamiento [cite: 34] ---
 void print_usage() {
-    fprintf(stderr, "Uso: toupperd <carpeta_origen> <carpeta_destino>\n");
+    fprintf(stderr, "Uso: toupperd [-v] [-j N] [-e stdio|mmap] [-c utf8|ascii] [-M socket|puerto]\n");
+    fprintf(stderr, "               [--max-inflight-bytes N[K|M|G]] [-r] <carpeta_origen> <carpeta_destino>\n");
+    fprintf(stderr, "       toupperd [opciones] -f configuración\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -f A   Lee los pares de carpetas de A, uno por línea:\n");
+    fprintf(stderr, "         <carpeta_origen> <carpeta_destino> [recursivo]\n");
+    fprintf(stderr, "         Cada origen tiene su propio escáner y su propia cola, y los\n");
+    fprintf(stderr, "         consumidores atienden las colas por turnos.\n");
+    fprintf(stderr, "  -r     Procesa también los subdirectorios del origen, reproduciéndolos\n");
+    fprintf(stderr, "         en el destino.\n");
+    fprintf(stderr, "  -j N   Cantidad de hilos consumidores (por defecto: uno por CPU).\n");
+    fprintf(stderr, "  -e M   Motor de E/S: stdio (por defecto) o mmap, que mapea en memoria\n");
+    fprintf(stderr, "         origen y destino de los archivos de 1 MiB o más.\n");
+    fprintf(stderr, "  -c C   Codificación del texto: utf8 (por defecto), que también pasa a\n");
+    fprintf(stderr, "         mayúsculas las letras acentuadas, ñ, ü, griego, cirílico, etc.,\n");
+    fprintf(stderr, "         o ascii, que sólo convierte a..z.\n");
+    fprintf(stderr, "  -M D   Expone métricas en formato Prometheus por HTTP: en el puerto D\n");
+    fprintf(stderr, "         de 127.0.0.1 si D es un número, o en el socket Unix D.\n");
+    fprintf(stderr, "  -v     Informa cada archivo procesado en la salida estándar.\n");
+    fprintf(stderr, "  --max-inflight-bytes N\n");
+    fprintf(stderr, "         Tope de bytes leídos y todavía no escritos, repartido entre las\n");
+    fprintf(stderr, "         fuentes (por defecto: 64M). Dentro de ese tope cada cola ajusta\n");
+    fprintf(stderr, "         su profundidad según el ritmo de los consumidores.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Los archivos de 256 KiB o más los lee un hilo aparte por fuente y sus\n");
+    fprintf(stderr, "fragmentos viajan por una cola propia, así los archivos chicos que\n");
+    fprintf(stderr, "llegan después no esperan detrás de ellos.\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "toupperd: Servicio para convertir archivos a mayúsculas.\n");
     fprintf(stderr, "Verifica si se han colocado uno o más archivos en <carpeta_origen>,\n");
@@ -41,172 +237,1560 @@ void print_usage() {
     fprintf(stderr, "todos los caracteres pasados a mayúscula. Los archivos originales\n");
     fprintf(stderr, "son eliminados tras el procesamiento.\n");
     fprintf(stderr, "\n");
+    fprintf(stderr, "Los archivos se detectan con inotify apenas terminan de escribirse o\n");
+    fprintf(stderr, "son movidos a <carpeta_origen>; al arrancar se procesan los pendientes.\n");
+    fprintf(stderr, "\n");
     fprintf(stderr, "Requerimientos: Implementado con hilos sincronizados (Productor/Consumidor).\n");
 }
 
-// --- Hilo Productor: Escanea y Carga Archivos [cite: 61, 62] ---
-void* hilo_productor(void* arg) {
+// --- Trabajos en curso ---
+// Crea un trabajo para el archivo, sin abrir nada todavía
+static Trabajo *nuevo_trabajo(Fuente *f, const char *nombre) {
+    Trabajo *t = calloc(1, sizeof(Trabajo));
+    if (t == NULL) {
+        return NULL;
+    }
+
+    // El temporal va siempre en la raíz del destino, aunque el archivo sea de
+    // un subdirectorio: ahí lo busca el diario si quedó huérfano
+    t->fuente = f;
+    snprintf(t->filename, sizeof(t->filename), "%s", nombre);
+    snprintf(t->temporal, sizeof(t->temporal), "%s/" DIARIO_PREFIJO "%lu.tmp", f->destino,
+             __atomic_fetch_add(&g_trabajos_creados, 1, __ATOMIC_RELAXED));
+    t->fd_destino = -1;
+    t->pendientes = 1; // La referencia del productor
+    t->descubierto_ns = metricas_ahora();
+    pthread_mutex_init(&t->mutex, NULL);
+    return t;
+}
+
+// Marca el archivo como en curso según su identidad (t->origen). Devuelve 0 si
+// ya había un trabajo para ese mismo archivo: un archivo puede notificarse dos
+// veces, o aparecer en un escaneo mientras se procesa, y la segunda vez se
+// descarta. La identidad sale del fstat() que igual hace falta para
+// cargarlo, así que el control no agrega syscalls.
+static int marcar_en_curso(Trabajo *t) {
+    Fuente *f = t->fuente;
+    pthread_mutex_lock(&f->en_curso_mutex);
+    int agregado = indice_agregar(&f->en_curso, &t->origen);
+    pthread_mutex_unlock(&f->en_curso_mutex);
+
+    // Sin memoria para el índice, se procesa igual aunque pueda repetirse
+    t->en_indice = agregado == 1;
+    return agregado != 0;
+}
+
+// Saca el trabajo del índice de en curso y lo libera
+static void retirar_trabajo(Trabajo *t) {
+    // Recién ahora el archivo puede volver a encolarse
+    if (t->en_indice) {
+        Fuente *f = t->fuente;
+        pthread_mutex_lock(&f->en_curso_mutex);
+        indice_quitar(&f->en_curso, &t->origen);
+        pthread_mutex_unlock(&f->en_curso_mutex);
+    }
+
+    pthread_mutex_destroy(&t->mutex);
+    free(t);
+}
+
+// Crea el temporal del trabajo. Si no puede, lo retira y devuelve -1.
+// Se abre para lectura y escritura: el motor mmap lo mapea con PROT_WRITE, y
+// eso no se permite sobre un descriptor de sólo escritura.
+static int abrir_temporal(Trabajo *t) {
+    t->fd_destino = open(t->temporal, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (t->fd_destino < 0) {
+        fprintf(stderr, "Productor: Error al crear el temporal %s: %s\n", t->temporal, strerror(errno));
+        retirar_trabajo(t);
+        return -1;
+    }
+    return 0;
+}
+
+// Descarta un trabajo que falló: borra el temporal y deja el original
+static void descartar_trabajo(Trabajo *t) {
+    fprintf(stderr, "Consumidor: Error al escribir en destino %s/%s\n", t->fuente->destino, t->filename);
+    metricas_sumar(CONTADOR_ERRORES, 1);
+    unlink(t->temporal);
+    retirar_trabajo(t);
+}
+
+// Pasa un temporal cerrado al confirmador de su fuente. El trabajo sigue en
+// curso (y el nombre no se vuelve a encolar) hasta que el confirmador lo retira.
+static void confirmar_trabajo(Trabajo *t) {
+    Fuente *f = t->fuente;
+    t->cerrado_ns = metricas_ahora();
+    t->siguiente_confirmar = NULL;
+
+    pthread_mutex_lock(&f->confirmar_mutex);
+    *f->confirmar_ultimo = t;
+    f->confirmar_ultimo = &t->siguiente_confirmar;
+    pthread_cond_signal(&f->confirmar_cond);
+    pthread_mutex_unlock(&f->confirmar_mutex);
+}
+
+// Cierra el temporal y, si no hubo errores, lo pasa al confirmador
+static void finalizar_trabajo(Trabajo *t) {
+    if (t->mapa_origen != NULL) {
+        munmap(t->mapa_origen, t->largo_mapa);
+        munmap(t->mapa_destino, t->largo_mapa);
+    }
+    if (close(t->fd_destino) != 0) {
+        t->error = 1;
+    }
+
+    if (t->error) {
+        descartar_trabajo(t);
+    } else {
+        confirmar_trabajo(t);
+    }
+}
+
+// Suelta una referencia al trabajo; el último en soltarlo lo finaliza.
+static void soltar_trabajo(Trabajo *t, int error) {
+    pthread_mutex_lock(&t->mutex);
+    t->error |= error;
+    int restantes = --t->pendientes;
+    pthread_mutex_unlock(&t->mutex);
+
+    if (restantes == 0) {
+        finalizar_trabajo(t);
+    }
+}
+
+// --- Presupuesto de bytes en vuelo ---
+// Cada entrada descuenta su cargo del presupuesto de su fuente antes de tomar
+// memoria, y el consumidor lo devuelve al terminar de escribirla. Una entrada
+// más grande que todo el límite igual pasa cuando su carril no tiene nada en
+// vuelo, así nunca queda trabada.
+// Reservan el productor (carril de chicos) y el lector de grandes de la
+// fuente; los consumidores devuelven.
+
+// Ajusta la profundidad de la cola según lo que pasó en el último período:
+//  - si el productor esperó presupuesto y además algún consumidor se quedó sin
+//    trabajo, la cola es demasiado corta para absorber las variaciones (una
+//    escritura lenta, una ráfaga de archivos): se duplica;
+//  - si el productor esperó pero los consumidores nunca pararon, ellos son el
+//    cuello de botella y más profundidad sólo suma memoria y latencia: se
+//    acerca a lo que los consumidores vacían en HORIZONTE_NS, de a un cuarto.
+// Lo hace el primero de los dos que reservan que encuentra el período vencido.
+static void adaptar_limite(Fuente *f, long ahora) {
+    if (ahora - __atomic_load_n(&f->periodo_ns, __ATOMIC_RELAXED) < ADAPTAR_NS
+        || pthread_mutex_trylock(&f->ajuste_mutex) != 0) {
+        return;
+    }
+    long transcurrido = ahora - f->periodo_ns;
+    if (transcurrido < ADAPTAR_NS) {
+        pthread_mutex_unlock(&f->ajuste_mutex);
+        return;
+    }
+    long producidos = __atomic_exchange_n(&f->producidos, 0, __ATOMIC_RELAXED);
+    long consumidos = __atomic_exchange_n(&f->consumidos, 0, __ATOMIC_RELAXED);
+    int bloqueos = __atomic_exchange_n(&f->bloqueos, 0, __ATOMIC_RELAXED);
+    unsigned long dormidas = __atomic_load_n(&g_dormidas, __ATOMIC_RELAXED);
+    int consumidores_parados = dormidas != f->dormidas_vistas;
+    long ritmo_salida = (long) (consumidos * 1e9 / transcurrido);
+    __atomic_store_n(&f->ritmo_entrada, (long) (producidos * 1e9 / transcurrido), __ATOMIC_RELAXED);
+    __atomic_store_n(&f->ritmo_salida, ritmo_salida, __ATOMIC_RELAXED);
+
+    long limite = f->limite;
+    if (bloqueos > 0 && consumidores_parados) {
+        limite *= 2;
+    } else if (bloqueos > 0) {
+        long objetivo = (long) (ritmo_salida * (HORIZONTE_NS / 1e9));
+        if (objetivo < limite) {
+            limite = objetivo > limite * 3 / 4 ? objetivo : limite * 3 / 4;
+        }
+    }
+    if (limite < LIMITE_MIN) {
+        limite = LIMITE_MIN;
+    }
+    if (limite > f->max_en_vuelo) {
+        limite = f->max_en_vuelo;
+    }
+    __atomic_store_n(&f->limite, limite, __ATOMIC_RELAXED);
+
+    f->dormidas_vistas = dormidas;
+    __atomic_store_n(&f->periodo_ns, ahora, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&f->ajuste_mutex);
+}
+
+// Los grandes usan a lo sumo la mitad del límite; los chicos, lo que quede
+// libre sin contar esa mitad, así siempre tienen al menos la otra mitad aunque
+// el lector tenga un archivo de varios GiB por delante.
+static int hay_presupuesto(Fuente *f, Carril carril, long cargo) {
+    long en_vuelo = __atomic_load_n(&f->en_vuelo, __ATOMIC_SEQ_CST);
+    long grandes = __atomic_load_n(&f->en_vuelo_grandes, __ATOMIC_SEQ_CST);
+    long limite = __atomic_load_n(&f->limite, __ATOMIC_RELAXED);
+    if (carril == CARRIL_GRANDES) {
+        return grandes == 0 || grandes + cargo <= limite / 2;
+    }
+    long chicos = en_vuelo - grandes;
+    long reservado = grandes < limite / 2 ? grandes : limite / 2;
+    return chicos == 0 || chicos + cargo + reservado <= limite;
+}
+
+static void reservar(Fuente *f, Carril carril, long cargo) {
+    adaptar_limite(f, metricas_ahora());
     while (1) {
-        DIR *dirp;
-        struct dirent *entry;
-        
-        // 1. Abrir y escanear el directorio origen
-        if ((dirp = opendir(g_origen_path)) == NULL) {
-            fprintf(stderr, "Productor: Error abriendo directorio origen %s\n", g_origen_path);
-            sleep(5);
+        // Leer el futex antes de mirar el presupuesto: si un consumidor lo
+        // devuelve en el medio, el futex ya cambió y no se duerme
+        unsigned visto = __atomic_load_n(&f->liberados, __ATOMIC_SEQ_CST);
+        if (hay_presupuesto(f, carril, cargo)) {
+            break;
+        }
+        __atomic_add_fetch(&f->bloqueos, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&f->esperando, 1, __ATOMIC_SEQ_CST);
+        if (!hay_presupuesto(f, carril, cargo)) {
+            futex_esperar(&f->liberados, visto);
+        }
+        __atomic_sub_fetch(&f->esperando, 1, __ATOMIC_SEQ_CST);
+    }
+    // Total antes que grandes, y al revés al liberar: entre las dos sumas los
+    // chicos se ven con más bytes en vuelo, nunca con menos
+    __atomic_add_fetch(&f->en_vuelo, cargo, __ATOMIC_SEQ_CST);
+    if (carril == CARRIL_GRANDES) {
+        __atomic_add_fetch(&f->en_vuelo_grandes, cargo, __ATOMIC_SEQ_CST);
+    }
+    __atomic_add_fetch(&f->producidos, cargo, __ATOMIC_RELAXED);
+}
+
+static void liberar(Fuente *f, Carril carril, long cargo) {
+    if (carril == CARRIL_GRANDES) {
+        __atomic_sub_fetch(&f->en_vuelo_grandes, cargo, __ATOMIC_SEQ_CST);
+    }
+    __atomic_sub_fetch(&f->en_vuelo, cargo, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&f->consumidos, cargo, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&f->liberados, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&f->esperando, __ATOMIC_SEQ_CST) > 0) {
+        // Pueden estar esperando los dos, cada uno por su carril
+        futex_despertar(&f->liberados, CARRILES);
+    }
+}
+
+// --- Pool de entradas ---
+// Las entradas pasan del pool al productor, del productor al consumidor a
+// través de la cola, y del consumidor de vuelta al pool. Hay una pila por clase
+// de capacidad, así un archivo de 2 KiB ocupa una entrada de 4 KiB y no una de
+// CHUNK_SIZE. Las lecturas y la conversión se hacen con la entrada en mano,
+// fuera de cualquier región crítica.
+// Toma una entrada con lugar para `capacidad` bytes de datos (hasta
+// CHUNK_SIZE), descontando `cargo` del presupuesto del carril; con cargo 0 se
+// descuenta la capacidad. Devuelve NULL si no hay memoria.
+static FileData *tomar_entrada(Fuente *f, Carril carril, long capacidad, long cargo) {
+    int clase = 0;
+    while (clases_pool[clase] < capacidad) {
+        clase++;
+    }
+    if (cargo == 0) {
+        cargo = clases_pool[clase];
+    }
+    cargo = cargo < CARGO_MIN ? CARGO_MIN : cargo;
+    reservar(f, carril, cargo);
+
+    pthread_mutex_lock(&pool_mutex);
+    FileData *e = pool_libres[clase];
+    if (e != NULL) {
+        pool_libres[clase] = e->siguiente_libre;
+        pool_libres_n--;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    if (e == NULL && (e = malloc(sizeof(FileData) + clases_pool[clase])) == NULL) {
+        liberar(f, carril, cargo);
+        return NULL;
+    }
+    memset(e, 0, sizeof(FileData));
+    e->fuente = f;
+    e->cargo = cargo;
+    e->clase = clase;
+    e->carril = carril;
+    e->content = e->datos;
+    return e;
+}
+
+// Devuelve la entrada al pool y su cargo al presupuesto de la fuente
+static void devolver_entrada(FileData *e) {
+    Fuente *f = e->fuente;
+    Carril carril = e->carril;
+    long cargo = e->cargo;
+
+    pthread_mutex_lock(&pool_mutex);
+    e->siguiente_libre = pool_libres[e->clase];
+    pool_libres[e->clase] = e;
+    pool_libres_n++;
+    pthread_mutex_unlock(&pool_mutex);
+
+    liberar(f, carril, cargo);
+}
+
+// --- Colas de las fuentes ---
+// Cada fuente tiene sus propias colas, así el productor de una carpeta con
+// mucha actividad sólo se frena contra su propio presupuesto y nunca ocupa el
+// de las demás. Devuelve el momento en que la entrada entró a la cola.
+static long encolar(FileData *entrada) {
+    Fuente *f = entrada->fuente;
+    long encolado = entrada->encolado_ns = metricas_ahora();
+
+    // 1. Publicar la entrada; el presupuesto ya se reservó al tomarla, y la
+    //    cola tiene lugar para todo el presupuesto, así que sólo se llena si
+    //    --max-inflight-bytes supera COLA_ENTRADAS_MAX entradas mínimas
+    //    Desde acá la entrada es del consumidor
+    while (cola_poner(&f->colas[entrada->carril], entrada) != 0) {
+        sched_yield();
+    }
+
+    // 2. Avisar a los consumidores, despertando a uno si hay dormidos
+    __atomic_add_fetch(&g_avisos, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_consumidores_dormidos, __ATOMIC_SEQ_CST) > 0) {
+        futex_despertar(&g_avisos, 1);
+    }
+    return encolado;
+}
+
+// Busca una entrada en las colas, en ronda a partir de la siguiente a la última
+// atendida por este consumidor (*turno), así cada fuente con trabajo pendiente
+// recibe su parte aunque otra tenga la cola siempre llena. En cada fuente se
+// mira primero el carril `primero` y después el otro.
+static FileData *buscar_entrada(int *turno, Carril primero) {
+    for (int k = 0; k < g_num_fuentes; k++) {
+        int i = (*turno + k) % g_num_fuentes;
+        Fuente *f = &g_fuentes[i];
+        FileData *entrada = cola_sacar(&f->colas[primero]);
+        if (entrada == NULL) {
+            entrada = cola_sacar(&f->colas[primero == CARRIL_CHICOS ? CARRIL_GRANDES : CARRIL_CHICOS]);
+        }
+        if (entrada != NULL) {
+            *turno = i + 1;
+            return entrada;
+        }
+    }
+    return NULL;
+}
+
+// Toma la próxima entrada para un consumidor, durmiendo si no hay ninguna.
+// Los chicos tienen prioridad: un archivo chico sale en cuanto un consumidor
+// termina lo que tiene en mano, sin esperar a los fragmentos de un grande que
+// llegó antes. Para que un goteo constante de chicos no deje parados a los
+// grandes, una de cada RONDA_GRANDES entradas (*tomadas cuenta las de este
+// consumidor) se busca primero en el carril de grandes.
+static FileData *tomar_descriptor(int *turno, unsigned long *tomadas) {
+    Carril primero = (*tomadas)++ % RONDA_GRANDES == 0 ? CARRIL_GRANDES : CARRIL_CHICOS;
+    while (1) {
+        FileData *entrada = buscar_entrada(turno, primero);
+        if (entrada != NULL) {
+            return entrada;
+        }
+
+        // Anotarse como dormido y volver a mirar: un productor que encola
+        // después de esta segunda búsqueda ve al consumidor dormido y lo
+        // despierta; uno que encoló antes cambió g_avisos y el futex no duerme
+        unsigned visto = __atomic_load_n(&g_avisos, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&g_consumidores_dormidos, 1, __ATOMIC_SEQ_CST);
+        entrada = buscar_entrada(turno, primero);
+        if (entrada == NULL) {
+            __atomic_add_fetch(&g_dormidas, 1, __ATOMIC_RELAXED);
+            futex_esperar(&g_avisos, visto);
+        }
+        __atomic_sub_fetch(&g_consumidores_dormidos, 1, __ATOMIC_SEQ_CST);
+        if (entrada != NULL) {
+            return entrada;
+        }
+    }
+}
+
+// --- Encolado de un fragmento ---
+// El fragmento suma una referencia al trabajo, que el consumidor suelta al
+// terminar de escribirlo.
+static void encolar_fragmento(FileData *fragmento) {
+    Trabajo *t = fragmento->trabajo;
+    int primero = fragmento->offset == 0;
+    pthread_mutex_lock(&t->mutex);
+    t->pendientes++;
+    pthread_mutex_unlock(&t->mutex);
+
+    long encolado = encolar(fragmento);
+    if (primero) {
+        metricas_observar(ETAPA_DESCUBRIMIENTO, encolado - t->descubierto_ns);
+    }
+    metricas_sumar(CONTADOR_FRAGMENTOS, 1);
+}
+
+// --- Motor stdio ---
+// El archivo se lee con fread() en fragmentos de hasta CHUNK_SIZE sobre entradas
+// del pool, así que no hay límite de tamaño y la memoria usada es la del
+// presupuesto. Cada entrada se pide del tamaño de lo que falta leer según
+// fstat() (más un byte, para ver el fin del archivo en la misma lectura).
+// En modo UTF-8, si un fragmento termina a mitad de un carácter, esos bytes pasan
+// al principio del siguiente.
+// Devuelve la cantidad de bytes encolados, o -1 si hubo un error de lectura.
+static off_t cargar_stdio(Trabajo *t, int fd_origen, off_t largo) {
+    FILE *f_in = fdopen(fd_origen, "rb");
+    if (f_in == NULL) {
+        close(fd_origen);
+        return -1;
+    }
+
+    off_t offset = 0;
+    char resto[4];      // Carácter cortado al final del fragmento anterior
+    long largo_resto = 0;
+    int fin = 0;
+
+    int error = 0;
+
+    while (!fin) {
+        // Leer el fragmento en una entrada propia, fuera de la región crítica
+        long falta = largo - offset + 1;
+        long capacidad = falta > CHUNK_SIZE ? CHUNK_SIZE : falta < largo_resto + 1 ? largo_resto + 1 : falta;
+        FileData *fragmento = tomar_entrada(t->fuente, t->carril, capacidad, 0);
+        if (fragmento == NULL) {
+            error = 1;
+            break;
+        }
+        char *buffer = fragmento->content;
+        capacidad = clases_pool[fragmento->clase];
+        memcpy(buffer, resto, largo_resto);
+        long pedido = capacidad - largo_resto;
+        long bytes_read = fread(buffer + largo_resto, 1, pedido, f_in);
+        long size = largo_resto + bytes_read;
+        fin = bytes_read < pedido;
+        if (size == 0) {
+            // Fin del archivo justo en el borde de un fragmento
+            devolver_entrada(fragmento);
+            break;
+        }
+
+        // Si no es el último, no partir un carácter entre dos fragmentos
+        largo_resto = 0;
+        if (!fin) {
+            size = mayus_corte(buffer, size);
+            largo_resto = capacidad - size;
+            memcpy(resto, buffer + size, largo_resto);
+        }
+
+        fragmento->trabajo = t;
+        fragmento->offset = offset;
+        fragmento->size = size;
+        encolar_fragmento(fragmento);
+        offset += size;
+    }
+
+    error |= ferror(f_in);
+
+    // Cierra el archivo de entrada después de cargarlo al buffer
+    fclose(f_in);
+    return error ? -1 : offset;
+}
+
+// --- Motor mmap ---
+// Origen y destino se mapean en memoria: el destino se reserva con
+// posix_fallocate() (así un disco lleno falla acá y no con SIGBUS al escribir
+// el mapa) y cada consumidor copia su fragmento de un mapa al otro y lo convierte
+// ahí mismo. Se evitan los buffers de stdio y la copia extra de write().
+//
+// Si otro proceso trunca el origen mientras está mapeado, leer más allá del
+// nuevo fin da SIGBUS. Cada lectura del mapa de origen se hace con un punto de
+// retorno en salto_sigbus: el manejador vuelve ahí y el trabajo falla (el
+// original queda, y el escritor lo vuelve a notificar al cerrarlo) en lugar
+// de matar el servicio.
+static __thread sigjmp_buf *salto_sigbus;
+
+static void atrapar_sigbus(int sig) {
+    if (salto_sigbus != NULL) {
+        siglongjmp(*salto_sigbus, 1);
+    }
+    // Fuera de un mapa de origen es un error de verdad
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Con SA_NODEFER la señal no queda bloqueada al salir del manejador con
+// siglongjmp(), así que no hace falta guardar la máscara en cada sigsetjmp()
+static void instalar_sigbus(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = atrapar_sigbus;
+    sa.sa_flags = SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, NULL);
+}
+
+// mayus_corte() sobre el mapa de origen. Devuelve -1 si el origen se truncó.
+static long corte_mapeado(const char *datos, long size) {
+    sigjmp_buf salto;
+    if (sigsetjmp(salto, 0) != 0) {
+        salto_sigbus = NULL;
+        return -1;
+    }
+    salto_sigbus = &salto;
+    size = mayus_corte(datos, size);
+    salto_sigbus = NULL;
+    return size;
+}
+
+// Copia un fragmento del mapa de origen al de destino y lo convierte ahí, de a
+// bloques que todavía están en la caché. Devuelve -1 si el origen se truncó.
+static int copiar_mapeado(FileData *fragmento) {
+    sigjmp_buf salto;
+    if (sigsetjmp(salto, 0) != 0) {
+        salto_sigbus = NULL;
+        return -1;
+    }
+    salto_sigbus = &salto;
+
+    long copia_ns = 0, conversion_ns = 0;
+    for (long i = 0, n; i < fragmento->size; i += n) {
+        n = fragmento->size - i < CHUNK_SIZE ? fragmento->size - i : CHUNK_SIZE;
+        if (i + n < fragmento->size) {
+            n = mayus_corte(fragmento->origen + i, n);
+        }
+        long t0 = metricas_ahora();
+        memcpy(fragmento->content + i, fragmento->origen + i, n);
+        long t1 = metricas_ahora();
+        mayus(fragmento->content + i, n);
+        copia_ns += t1 - t0;
+        conversion_ns += metricas_ahora() - t1;
+    }
+    salto_sigbus = NULL;
+
+    metricas_observar(ETAPA_CONVERSION, conversion_ns);
+    metricas_observar(ETAPA_ESCRITURA, copia_ns);
+    return 0;
+}
+
+// Devuelve la cantidad de bytes encolados, o -1 si no se pudo mapear (en ese
+// caso el archivo sigue abierto y puede cargarse con el motor stdio).
+static off_t cargar_mmap(Trabajo *t, int fd_origen, off_t largo) {
+    posix_fadvise(fd_origen, 0, largo, POSIX_FADV_SEQUENTIAL);
+
+    char *origen = mmap(NULL, largo, PROT_READ, MAP_SHARED, fd_origen, 0);
+    if (origen == MAP_FAILED) {
+        return -1;
+    }
+    madvise(origen, largo, MADV_SEQUENTIAL);
+
+    int reservado = posix_fallocate(t->fd_destino, 0, largo);
+    if (reservado == EOPNOTSUPP || reservado == EINVAL) {
+        // El sistema de archivos no permite reservar: al menos fijar el tamaño
+        reservado = ftruncate(t->fd_destino, largo) == 0 ? 0 : errno;
+    }
+    char *destino = reservado == 0
+        ? mmap(NULL, largo, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd_destino, 0)
+        : MAP_FAILED;
+    if (destino == MAP_FAILED) {
+        munmap(origen, largo);
+        return -1;
+    }
+
+    // El origen ya no hace falta abierto: el mapa lo mantiene
+    close(fd_origen);
+    t->mapa_origen = origen;
+    t->mapa_destino = destino;
+    t->largo_mapa = largo;
+
+    // Fragmentos de hasta un cuarto del límite de la fuente, así aun con una
+    // cola corta hay varios en vuelo y los convierten varios consumidores a la vez
+    long maximo = __atomic_load_n(&t->fuente->limite, __ATOMIC_RELAXED) / 4;
+    maximo = maximo > MMAP_CHUNK_SIZE ? MMAP_CHUNK_SIZE : maximo < CHUNK_SIZE ? CHUNK_SIZE : maximo;
+    for (off_t offset = 0; offset < largo; ) {
+        long size = largo - offset < maximo ? largo - offset : maximo;
+        if (offset + size < largo && (size = corte_mapeado(origen + offset, size)) < 0) {
+            return -1; // Sin partir caracteres; falla si el origen se truncó
+        }
+        // Los datos están en los mapas: la entrada es sólo el descriptor, pero
+        // descuenta el tamaño del fragmento del presupuesto
+        FileData *fragmento = tomar_entrada(t->fuente, t->carril, 0, size);
+        if (fragmento == NULL) {
+            return -1;
+        }
+        fragmento->trabajo = t;
+        fragmento->offset = offset;
+        fragmento->origen = origen + offset;
+        fragmento->content = destino + offset;
+        fragmento->size = size;
+        encolar_fragmento(fragmento);
+        offset += size;
+    }
+    return largo;
+}
+
+// --- Lectura de un archivo al buffer [cite: 61, 62] ---
+// Encola los fragmentos del trabajo con el motor elegido y suelta la
+// referencia de quien lo leyó (el productor o el lector de grandes).
+static void leer_trabajo(Trabajo *t, int fd_origen, off_t largo) {
+    // Los archivos chicos siempre van por stdio, donde mapearlos cuesta más de
+    // lo que ahorra
+    off_t cargado = -1;
+    if (g_motor == MOTOR_MMAP && largo >= MMAP_MIN_SIZE) {
+        cargado = cargar_mmap(t, fd_origen, largo);
+    }
+    if (cargado < 0 && t->mapa_origen == NULL) {
+        posix_fadvise(fd_origen, 0, 0, POSIX_FADV_SEQUENTIAL);
+        cargado = cargar_stdio(t, fd_origen, largo);
+    }
+
+    int error = cargado < 0;
+    t->bytes = cargado;
+    if (error) {
+        fprintf(stderr, "Productor: Error leyendo %s/%s\n", t->fuente->origen, t->filename);
+    } else {
+        VERBOSO("Productor: Archivo '%s' cargado al buffer. (Tamaño: %lld)\n", t->filename, (long long) cargado);
+    }
+
+    soltar_trabajo(t, error);
+}
+
+// Deja un archivo grande, ya abierto, pendiente para el lector de su fuente
+static void entregar_grande(Trabajo *t, int fd_origen, off_t largo) {
+    Fuente *f = t->fuente;
+    t->carril = CARRIL_GRANDES;
+    t->fd_origen = fd_origen;
+    t->largo = largo;
+    t->siguiente_grande = NULL;
+
+    pthread_mutex_lock(&f->grandes_mutex);
+    *f->grandes_ultimo = t;
+    f->grandes_ultimo = &t->siguiente_grande;
+    f->num_grandes++;
+    pthread_cond_signal(&f->grandes_cond);
+    pthread_mutex_unlock(&f->grandes_mutex);
+}
+
+// --- Carga de un archivo al buffer [cite: 61, 62] ---
+// Los archivos de GRANDE_MIN_SIZE o más sólo se abren acá: los lee el lector de
+// grandes, y el productor sigue con lo que llegó detrás.
+// Devuelve 0 si el archivo fue encolado, -1 si no se pudo abrir.
+static int cargar_archivo(Fuente *f, const char *nombre) {
+    char full_path_origen[RUTA_MAX];
+    snprintf(full_path_origen, sizeof(full_path_origen), "%s/%s", f->origen, nombre);
+
+    // 1. Intentar abrir el archivo
+    int fd_origen = open(full_path_origen, O_RDONLY | O_CLOEXEC);
+    if (fd_origen < 0) {
+        // Pudo haber sido eliminado o renombrado antes de llegar a leerlo
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd_origen, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd_origen);
+        return -1;
+    }
+
+    Trabajo *t = nuevo_trabajo(f, nombre);
+    if (t == NULL) {
+        close(fd_origen);
+        return -1;
+    }
+    t->origen = (Identidad) {
+        .dev = st.st_dev,
+        .ino = st.st_ino,
+        .size = st.st_size,
+        .mtime_s = st.st_mtim.tv_sec,
+        .mtime_ns = st.st_mtim.tv_nsec,
+    };
+
+    // 2. Descartarlo si este mismo archivo ya está en curso
+    if (!marcar_en_curso(t)) {
+        retirar_trabajo(t);
+        close(fd_origen);
+        return 0;
+    }
+    if (abrir_temporal(t) != 0) {
+        close(fd_origen);
+        return -1;
+    }
+
+    // 3. Encolar sus fragmentos, o pasárselo al lector si es grande
+    if (st.st_size >= GRANDE_MIN_SIZE) {
+        entregar_grande(t, fd_origen, st.st_size);
+    } else {
+        leer_trabajo(t, fd_origen, st.st_size);
+    }
+    return 0;
+}
+
+// --- Hilo Lector de Grandes ---
+// Hay uno por fuente. Toma los archivos grandes pendientes de a uno, el más
+// chico primero: con el costo estimado por el tamaño, así un archivo de 300 KiB
+// no espera a que se lea uno de 10 GiB que llegó antes. Para que un goteo de
+// grandes medianos no postergue para siempre al más grande, uno que lleva más
+// de ESPERA_GRANDE_MAX_NS pendiente pasa primero.
+// Sus fragmentos van al carril de grandes, donde varios consumidores los
+// convierten a la vez y los escriben en su lugar del temporal.
+static Trabajo *siguiente_grande(Fuente *f) {
+    pthread_mutex_lock(&f->grandes_mutex);
+    while (f->grandes_primero == NULL) {
+        pthread_cond_wait(&f->grandes_cond, &f->grandes_mutex);
+    }
+
+    // El primero es el más antiguo; si no esperó demasiado, el más chico
+    Trabajo **elegido = &f->grandes_primero;
+    if (metricas_ahora() - f->grandes_primero->descubierto_ns < ESPERA_GRANDE_MAX_NS) {
+        for (Trabajo **p = &f->grandes_primero; *p != NULL; p = &(*p)->siguiente_grande) {
+            if ((*p)->largo < (*elegido)->largo) {
+                elegido = p;
+            }
+        }
+    }
+    Trabajo *t = *elegido;
+    *elegido = t->siguiente_grande;
+    if (f->grandes_ultimo == &t->siguiente_grande) {
+        f->grandes_ultimo = elegido;
+    }
+    f->num_grandes--;
+    pthread_mutex_unlock(&f->grandes_mutex);
+    return t;
+}
+
+void* hilo_lector(void* arg) {
+    Fuente *f = arg;
+    while (1) {
+        Trabajo *t = siguiente_grande(f);
+        leer_trabajo(t, t->fd_origen, t->largo);
+    }
+    return NULL;
+}
+
+// Los nombres con DIARIO_PREFIJO son del diario y los temporales: un archivo
+// del origen así llamado se deja donde está (ver diario.h)
+static int nombre_reservado(const char *dir, const char *nombre) {
+    if (strncmp(nombre, DIARIO_PREFIJO, strlen(DIARIO_PREFIJO)) != 0) {
+        return 0;
+    }
+    fprintf(stderr, "Productor: Se ignora %s%s%s: el prefijo %s es del servicio\n",
+            dir, dir[0] != '\0' ? "/" : "", nombre, DIARIO_PREFIJO);
+    return 1;
+}
+
+// Une un subdirectorio relativo ("" para la raíz) y un nombre. Devuelve -1 si
+// no entra en NOMBRE_MAX.
+static int unir_relativo(char *salida, const char *dir, const char *nombre) {
+    int n = dir[0] != '\0' ? snprintf(salida, NOMBRE_MAX, "%s/%s", dir, nombre)
+                           : snprintf(salida, NOMBRE_MAX, "%s", nombre);
+    return n < NOMBRE_MAX ? 0 : -1;
+}
+
+// --- Vigilancia de subdirectorios ---
+// Con recursión, cada subdirectorio del origen tiene su propia vigilancia de
+// inotify; los eventos traen el descriptor de la vigilancia y el nombre dentro
+// de ese directorio, así que se guarda el subdirectorio de cada descriptor.
+#define MASCARA_INOTIFY (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define MASCARA_INOTIFY_RECURSIVA (MASCARA_INOTIFY | IN_CREATE)
+
+static int vigilar(Fuente *f, const char *dir) {
+    char ruta[RUTA_MAX];
+    snprintf(ruta, sizeof(ruta), "%s/%s", f->origen, dir);
+    int wd = inotify_add_watch(f->inotify, ruta,
+                               f->recursivo ? MASCARA_INOTIFY_RECURSIVA : MASCARA_INOTIFY);
+    if (wd < 0) {
+        return -1;
+    }
+
+    if (wd >= f->num_vigilados) {
+        int n = wd * 2 + 16;
+        char **vigilados = realloc(f->vigilados, n * sizeof(char *));
+        if (vigilados == NULL) {
+            inotify_rm_watch(f->inotify, wd);
+            return -1;
+        }
+        memset(vigilados + f->num_vigilados, 0, (n - f->num_vigilados) * sizeof(char *));
+        f->vigilados = vigilados;
+        f->num_vigilados = n;
+    }
+    // Volver a vigilar un directorio devuelve el mismo descriptor
+    free(f->vigilados[wd]);
+    f->vigilados[wd] = strdup(dir);
+    return 0;
+}
+
+// Subdirectorio de un evento, o NULL si la vigilancia ya no existe
+static const char *vigilado(Fuente *f, int wd) {
+    return wd >= 0 && wd < f->num_vigilados ? f->vigilados[wd] : NULL;
+}
+
+// --- Escaneo de un directorio del origen ---
+// Encola todos los archivos presentes en `dir` (relativo al origen) y, con
+// recursión, en sus subdirectorios, que además se vigilan y se crean en el
+// destino. La vigilancia se registra ANTES de leer el directorio, así ningún
+// archivo que llegue durante el escaneo se pierde.
+static void escanear_directorio(Fuente *f, const char *dir) {
+    char ruta[RUTA_MAX];
+    snprintf(ruta, sizeof(ruta), "%s/%s", f->origen, dir);
+
+    if (dir[0] != '\0') {
+        if (f->inotify >= 0 && vigilar(f, dir) != 0) {
+            fprintf(stderr, "Productor: No se pudo vigilar %s (%s), se revisará al reescanear\n",
+                    ruta, strerror(errno));
+        }
+        char destino[RUTA_MAX];
+        snprintf(destino, sizeof(destino), "%s/%s", f->destino, dir);
+        if (mkdir(destino, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Productor: Error creando %s: %s\n", destino, strerror(errno));
+            return;
+        }
+    }
+
+    DIR *dirp = opendir(ruta);
+    if (dirp == NULL) {
+        fprintf(stderr, "Productor: Error abriendo directorio origen %s\n", ruta);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dirp)) != NULL) {
+        // Ignorar . y .., los nombres reservados y, sin recursión, los subdirectorios
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            nombre_reservado(dir, entry->d_name)) {
             continue;
         }
+        int es_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            // El sistema de archivos no informa el tipo en readdir()
+            struct stat st;
+            es_dir = fstatat(dirfd(dirp), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+                     S_ISDIR(st.st_mode);
+        }
+        if (es_dir && !f->recursivo) {
+            continue;
+        }
+
+        char nombre[NOMBRE_MAX];
+        if (unir_relativo(nombre, dir, entry->d_name) != 0) {
+            fprintf(stderr, "Productor: Ruta demasiado larga en %s: %s\n", ruta, entry->d_name);
+            continue;
+        }
+        if (es_dir) {
+            escanear_directorio(f, nombre);
+        } else {
+            cargar_archivo(f, nombre);
+        }
+    }
 
-        while ((entry = readdir(dirp)) != NULL) {
-            // Ignorar . y ..
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+    closedir(dirp);
+}
+
+// --- Escaneo completo del origen ---
+// Se usa al arrancar (para levantar los archivos que llegaron con el servicio
+// detenido) y cuando inotify pierde eventos.
+static void escanear_origen(Fuente *f) {
+    escanear_directorio(f, "");
+}
+
+// --- Hilo Productor: Espera eventos de inotify y Carga Archivos [cite: 61, 62] ---
+// Hay uno por fuente. Los archivos se encolan apenas terminan de escribirse
+// (IN_CLOSE_WRITE) o son movidos al origen (IN_MOVED_TO), sin esperas fijas
+// entre escaneos. Con recursión, los subdirectorios nuevos (IN_CREATE o
+// IN_MOVED_TO de un directorio) se vigilan y se escanean al aparecer.
+void* hilo_productor(void* arg) {
+    Fuente *f = arg;
+    char eventos[INOTIFY_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    f->inotify = inotify_init1(IN_CLOEXEC);
+
+    // 1. Registrar la vigilancia ANTES del escaneo inicial, así ningún archivo
+    //    que llegue durante el escaneo se pierde.
+    if (f->inotify < 0 || vigilar(f, "") != 0) {
+        fprintf(stderr, "Productor: inotify no disponible para %s (%s), se escaneará cada %d segundos\n",
+                f->origen, strerror(errno), POLL_INTERVAL);
+        if (f->inotify >= 0) {
+            close(f->inotify);
+            f->inotify = -1;
+        }
+        // Modo de respaldo: escaneo periódico [cite: 46]
+        while (1) {
+            escanear_origen(f);
+            sleep(POLL_INTERVAL);
+        }
+    }
+
+    // 2. Escaneo inicial para procesar los archivos pendientes
+    escanear_origen(f);
+
+    // 3. Bucle de eventos
+    while (1) {
+        ssize_t len = read(f->inotify, eventos, sizeof(eventos));
+        if (len < 0) {
+            if (errno == EINTR) {
                 continue;
             }
+            perror("Productor: Error leyendo eventos de inotify");
+            break;
+        }
 
-            char full_path_origen[512];
-            snprintf(full_path_origen, sizeof(full_path_origen), "%s/%s", g_origen_path, entry->d_name);
+        for (char *p = eventos; p < eventos + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + ev->len;
 
-            // 2. Intentar leer el archivo
-            FILE *f_in = fopen(full_path_origen, "rb");
-            if (f_in == NULL) {
-                // Podría estar siendo escrito por otro proceso, ignorar por ahora
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // Se perdieron eventos: volver a escanear todo el origen
+                escanear_origen(f);
                 continue;
             }
-            
-            // Leer el contenido
-            long bytes_read;
-            
-            // 3. Esperar a que haya un espacio vacío en el buffer [cite: 58]
-            sem_wait(&sem_empty);
-
-            // 4. Bloquear la región crítica del buffer
-            pthread_mutex_lock(&buffer_mutex);
-
-            // --- Región Crítica (Escribir en Buffer) ---
-            bytes_read = fread(shared_buffer[buffer_in].content, 1, FILE_MAX_SIZE, f_in);
-            shared_buffer[buffer_in].size = bytes_read;
-            strncpy(shared_buffer[buffer_in].filename, entry->d_name, sizeof(shared_buffer[buffer_in].filename) - 1);
-            
-            buffer_in = (buffer_in + 1) % BUFFER_SIZE;
-            // --- Fin Región Crítica ---
-
-            // 5. Desbloquear la región crítica
-            pthread_mutex_unlock(&buffer_mutex);
-
-            // 6. Señalizar que hay un espacio lleno
-            sem_post(&sem_full);
-            
-            printf("Productor: Archivo '%s' cargado al buffer. (Tamaño: %ld)\n", entry->d_name, bytes_read);
-            
-            // Cierra el archivo de entrada después de cargarlo al buffer
-            fclose(f_in);
-            break; // Solo procesa un archivo por escaneo para evitar monopolizar
-        }
-        
-        closedir(dirp);
-        sleep(2); // Espera antes de volver a escanear [cite: 46]
+            if (ev->mask & IN_IGNORED) {
+                // El directorio se borró o se movió fuera del origen
+                if (vigilado(f, ev->wd) != NULL) {
+                    free(f->vigilados[ev->wd]);
+                    f->vigilados[ev->wd] = NULL;
+                }
+                continue;
+            }
+            const char *dir = vigilado(f, ev->wd);
+            if (dir == NULL || ev->len == 0 || nombre_reservado(dir, ev->name)) {
+                continue;
+            }
+
+            char nombre[NOMBRE_MAX];
+            if (unir_relativo(nombre, dir, ev->name) != 0) {
+                fprintf(stderr, "Productor: Ruta demasiado larga en %s/%s: %s\n", f->origen, dir, ev->name);
+                continue;
+            }
+            if (ev->mask & IN_ISDIR) {
+                // Un subdirectorio nuevo puede traer archivos que no generaron
+                // eventos (si se movió entero, o antes de vigilarlo)
+                if (f->recursivo && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    escanear_directorio(f, nombre);
+                }
+                continue;
+            }
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                cargar_archivo(f, nombre);
+            }
+        }
     }
+
+    close(f->inotify);
     return NULL;
 }
 
 // --- Hilo Consumidor: Procesa, Guarda y Elimina Archivos [cite: 63] ---
+// Se lanzan g_num_consumidores instancias que atienden las colas de todas las
+// fuentes.
 void* hilo_consumidor(void* arg) {
+    int turno = 0; // Próxima fuente a atender
+    unsigned long tomadas = 0;
+
     while (1) {
-        // 1. Esperar a que haya un espacio lleno
-        sem_wait(&sem_full);
+        // 1-4. Tomar una entrada de alguna de las colas, en ronda
+        FileData *fragmento = tomar_descriptor(&turno, &tomadas);
 
-        // 2. Bloquear la región crítica del buffer
-        pthread_mutex_lock(&buffer_mutex);
+        long inicio = metricas_ahora();
+        metricas_observar(ETAPA_COLA, inicio - fragmento->encolado_ns);
 
-        // --- Región Crítica (Leer de Buffer) ---
-        // Copia local para liberar rápido el mutex
-        char current_filename[256];
-        char current_content[FILE_MAX_SIZE];
-        long current_size;
+        // --- Procesamiento (Fuera de la Región Crítica) ---
+        int error = 0;
+        if (fragmento->origen != NULL) {
+            // Motor mmap: copiar del mapa de origen al de destino y convertir ahí
+            error = copiar_mapeado(fragmento) != 0;
+        } else {
+            // La conversión se hace en el mismo buffer, sin copias
+            mayus(fragmento->content, fragmento->size);
+            long convertido = metricas_ahora();
+            metricas_observar(ETAPA_CONVERSION, convertido - inicio);
 
-        current_size = shared_buffer[buffer_out].size;
-        strncpy(current_filename, shared_buffer[buffer_out].filename, sizeof(current_filename) - 1);
-        memcpy(current_content, shared_buffer[buffer_out].content, current_size);
-        
-        buffer_out = (buffer_out + 1) % BUFFER_SIZE;
-        // --- Fin Región Crítica ---
+            // 5. Escribir el fragmento en su lugar dentro del temporal
+            for (long escrito = 0; escrito < fragmento->size; ) {
+                ssize_t n = pwrite(fragmento->trabajo->fd_destino, fragmento->content + escrito,
+                                   fragmento->size - escrito, fragmento->offset + escrito);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    error = 1;
+                    break;
+                }
+                escrito += n;
+            }
+            metricas_observar(ETAPA_ESCRITURA, metricas_ahora() - convertido);
+        }
 
-        // 3. Desbloquear la región crítica
-        pthread_mutex_unlock(&buffer_mutex);
+        // 6. Devolver la entrada y su presupuesto y, si era el último fragmento
+        //    pendiente, renombrar al destino y eliminar el archivo original [cite: 63]
+        Trabajo *t = fragmento->trabajo;
+        devolver_entrada(fragmento);
+        soltar_trabajo(t, error);
+    }
+    return NULL;
+}
 
-        // 4. Señalizar que hay un espacio vacío
-        sem_post(&sem_empty);
+// Devuelve un grupo que no se pudo anotar al frente de la cola del confirmador,
+// en el mismo orden, delante de lo que llegó mientras tanto
+static void devolver_grupo(Fuente *f, Trabajo **grupo, int n) {
+    for (int i = 0; i < n - 1; i++) {
+        grupo[i]->siguiente_confirmar = grupo[i + 1];
+    }
+    pthread_mutex_lock(&f->confirmar_mutex);
+    grupo[n - 1]->siguiente_confirmar = f->confirmar_primero;
+    if (f->confirmar_primero == NULL) {
+        f->confirmar_ultimo = &grupo[n - 1]->siguiente_confirmar;
+    }
+    f->confirmar_primero = grupo[0];
+    pthread_mutex_unlock(&f->confirmar_mutex);
+}
 
-        // --- Procesamiento (Fuera de la Región Crítica) ---
-        // Ahora el procesamiento se hace sobre la copia local
-        for (long i = 0; i < current_size; i++) {
-            current_content[i] = toupper(current_content[i]);
-        }
-
-        char full_path_destino[512];
-        snprintf(full_path_destino, sizeof(full_path_destino), "%s/%s", g_destino_path, current_filename);
-        
-        // 5. Escribir el archivo en destino
-        FILE *f_out = fopen(full_path_destino, "wb");
-        if (f_out) {
-            fwrite(current_content, 1, current_size, f_out);
-            fclose(f_out);
-            printf("Consumidor: Archivo '%s' procesado y guardado en destino.\n", current_filename);
-        } else {
-            fprintf(stderr, "Consumidor: Error al escribir en destino %s\n", full_path_destino); 
-        }
-        
-        // 6. Eliminar el archivo original [cite: 63]
-        char full_path_origen[512];
-        snprintf(full_path_origen, sizeof(full_path_origen), "%s/%s", g_origen_path, current_filename);
-        if (remove(full_path_origen) != 0) {
-            fprintf(stderr, "Consumidor: Error al eliminar el archivo original %s\n", full_path_origen);
-        } else {
-            printf("Consumidor: Archivo original '%s' eliminado.\n", current_filename);
+// --- Hilo Confirmador: Renombra al Destino y Elimina los Originales [cite: 63] ---
+// Confirma los temporales de a grupos: un syncfs() pasa a disco los datos de
+// todos, una escritura con fdatasync() los anota en el diario, y recién entonces
+// se renombran al destino y se borran los originales. Si el servicio se cae en
+// el medio, al arrancar se rehace lo anotado (ver diario.c). Son dos
+// sincronizaciones por grupo y no por archivo: mientras se sincroniza un grupo,
+// los consumidores van juntando el siguiente.
+// Hay uno por fuente, con su propio diario: cada destino se sincroniza por
+// separado.
+// Si un grupo no se puede sincronizar o anotar, nada de él se renombró: vuelve
+// a la cola y se reintenta, esperando el doble cada vez hasta REINTENTO_MAX_NS.
+// Descartarlo dejaría los originales en el origen sin ningún evento de inotify
+// que los vuelva a encolar hasta el próximo arranque.
+void* hilo_confirmador(void* arg) {
+    Fuente *f = arg;
+    Trabajo *grupo[CONFIRMAR_MAX];
+    Confirmacion registros[CONFIRMAR_MAX];
+    long espera_ns = 0; // Espera antes del próximo reintento; 0 si el último grupo salió bien
+
+    while (1) {
+        // 1. Tomar todo lo que esté esperando, hasta CONFIRMAR_MAX
+        pthread_mutex_lock(&f->confirmar_mutex);
+        while (f->confirmar_primero == NULL) {
+            pthread_cond_wait(&f->confirmar_cond, &f->confirmar_mutex);
+        }
+        int n = 0;
+        while (f->confirmar_primero != NULL && n < CONFIRMAR_MAX) {
+            grupo[n++] = f->confirmar_primero;
+            f->confirmar_primero = f->confirmar_primero->siguiente_confirmar;
+        }
+        if (f->confirmar_primero == NULL) {
+            f->confirmar_ultimo = &f->confirmar_primero;
         }
+        pthread_mutex_unlock(&f->confirmar_mutex);
+
+        // 2. Datos de los temporales a disco, y el grupo anotado en el diario
+        for (int i = 0; i < n; i++) {
+            registros[i] = (Confirmacion) {
+                .temporal = grupo[i]->temporal,
+                .nombre = grupo[i]->filename,
+                .origen = grupo[i]->origen,
+            };
+        }
+        int error = diario_sincronizar_datos(&f->diario) != 0 ||
+                    diario_anotar(&f->diario, registros, n) != 0;
+        metricas_sumar(CONTADOR_SINCRONIZACIONES, 2);
+        if (error) {
+            int e = errno;
+            espera_ns = espera_ns == 0 ? REINTENTO_MIN_NS
+                      : espera_ns * 2 > REINTENTO_MAX_NS ? REINTENTO_MAX_NS : espera_ns * 2;
+            fprintf(stderr, "Confirmador: Error al sincronizar el destino %s: %s; se reintenta en %ld ms\n",
+                    f->destino, strerror(e), espera_ns / 1000000);
+            devolver_grupo(f, grupo, n);
+            struct timespec espera = { espera_ns / 1000000000L, espera_ns % 1000000000L };
+            while (nanosleep(&espera, &espera) != 0 && errno == EINTR) {
+            }
+            continue;
+        }
+        espera_ns = 0;
+        long confirmado = metricas_ahora();
+
+        // 3. Renombrar al destino y eliminar el original
+        for (int i = 0; i < n; i++) {
+            Trabajo *t = grupo[i];
+            metricas_observar(ETAPA_CONFIRMACION, confirmado - t->cerrado_ns);
+            char destino[RUTA_MAX], origen[RUTA_MAX];
+            snprintf(destino, sizeof(destino), "%s/%s", f->destino, t->filename);
+            snprintf(origen, sizeof(origen), "%s/%s", f->origen, t->filename);
+            if (rename(t->temporal, destino) != 0) {
+                descartar_trabajo(t);
+                continue;
+            }
+
+            // Borrar el original sólo si sigue siendo el archivo que se leyó,
+            // como al reproducir el diario. Un escritor que deja un temporal y
+            // lo renombra sobre el original pudo reemplazarlo durante la
+            // confirmación (el syncfs() puede tardar cientos de ms): el nuevo
+            // todavía no se procesó, y llega con su propio IN_MOVED_TO.
+            struct stat st;
+            int reemplazado = stat(origen, &st) == 0 && !diario_misma_identidad(&st, &t->origen);
+            int eliminado = !reemplazado && remove(origen) == 0;
+
+            metricas_observar(ETAPA_ELIMINACION, metricas_ahora() - confirmado);
+            metricas_sumar(CONTADOR_ARCHIVOS, 1);
+            metricas_sumar(CONTADOR_BYTES, t->bytes);
+            VERBOSO("Consumidor: Archivo '%s' procesado y guardado en destino.\n", t->filename);
+            if (eliminado) {
+                VERBOSO("Consumidor: Archivo original '%s' eliminado.\n", t->filename);
+            } else if (reemplazado) {
+                VERBOSO("Consumidor: Archivo original '%s' reemplazado mientras se procesaba, se conserva.\n",
+                        t->filename);
+            } else {
+                fprintf(stderr, "Consumidor: Error al eliminar el archivo original %s\n", origen);
+            }
+            retirar_trabajo(t);
+        }
+
+        // Todo lo anotado ya está renombrado y borrado; compactar lo hace
+        // durable antes de vaciar el diario
+        diario_compactar(&f->diario);
     }
     return NULL;
 }
 
+// --- Medidores instantáneos para las métricas ---
+// Los de cada fuente llevan la etiqueta fuente="<carpeta_origen>".
+typedef enum {
+    MEDIDOR_ENTRADAS,
+    MEDIDOR_ENTRADAS_GRANDES,
+    MEDIDOR_GRANDES_PENDIENTES,
+    MEDIDOR_EN_VUELO,
+    MEDIDOR_EN_VUELO_GRANDES,
+    MEDIDOR_LIMITE,
+    MEDIDOR_RITMO_ENTRADA,
+    MEDIDOR_RITMO_SALIDA,
+} MedidorFuente;
+
+static void exportar_medidor_fuentes(FILE *salida, const char *nombre, const char *ayuda,
+                                     MedidorFuente medidor) {
+    fprintf(salida, "# HELP toupperd_%s %s\n", nombre, ayuda);
+    fprintf(salida, "# TYPE toupperd_%s gauge\n", nombre);
+    for (int i = 0; i < g_num_fuentes; i++) {
+        Fuente *f = &g_fuentes[i];
+        long valor;
+        switch (medidor) {
+        case MEDIDOR_ENTRADAS:
+            valor = cola_ocupados(&f->colas[CARRIL_CHICOS]);
+            break;
+        case MEDIDOR_ENTRADAS_GRANDES:
+            valor = cola_ocupados(&f->colas[CARRIL_GRANDES]);
+            break;
+        case MEDIDOR_GRANDES_PENDIENTES:
+            valor = __atomic_load_n(&f->num_grandes, __ATOMIC_RELAXED);
+            break;
+        case MEDIDOR_EN_VUELO:
+            valor = __atomic_load_n(&f->en_vuelo, __ATOMIC_RELAXED);
+            break;
+        case MEDIDOR_EN_VUELO_GRANDES:
+            valor = __atomic_load_n(&f->en_vuelo_grandes, __ATOMIC_RELAXED);
+            break;
+        case MEDIDOR_LIMITE:
+            valor = __atomic_load_n(&f->limite, __ATOMIC_RELAXED);
+            break;
+        case MEDIDOR_RITMO_ENTRADA:
+            valor = __atomic_load_n(&f->ritmo_entrada, __ATOMIC_RELAXED);
+            break;
+        default:
+            valor = __atomic_load_n(&f->ritmo_salida, __ATOMIC_RELAXED);
+            break;
+        }
+        fprintf(salida, "toupperd_%s{fuente=", nombre);
+        metricas_etiqueta(salida, f->origen);
+        fprintf(salida, "} %ld\n", valor);
+    }
+}
+
+static void exportar_medidores(FILE *salida) {
+    pthread_mutex_lock(&pool_mutex);
+    int libres = pool_libres_n;
+    pthread_mutex_unlock(&pool_mutex);
+
+    exportar_medidor_fuentes(salida, "cola_entradas", "Entradas en el carril de chicos de la fuente.",
+                             MEDIDOR_ENTRADAS);
+    exportar_medidor_fuentes(salida, "cola_grandes_entradas",
+                             "Entradas en el carril de grandes de la fuente.", MEDIDOR_ENTRADAS_GRANDES);
+    exportar_medidor_fuentes(salida, "grandes_pendientes",
+                             "Archivos grandes abiertos que esperan al lector.", MEDIDOR_GRANDES_PENDIENTES);
+    exportar_medidor_fuentes(salida, "cola_en_vuelo_bytes",
+                             "Bytes de entradas de la fuente encoladas o en proceso.", MEDIDOR_EN_VUELO);
+    exportar_medidor_fuentes(salida, "cola_grandes_en_vuelo_bytes",
+                             "Parte de cola_en_vuelo_bytes del carril de grandes.", MEDIDOR_EN_VUELO_GRANDES);
+    exportar_medidor_fuentes(salida, "cola_limite_bytes", "Profundidad actual de la cola, en bytes.",
+                             MEDIDOR_LIMITE);
+    exportar_medidor_fuentes(salida, "cola_ritmo_entrada_bytes",
+                             "Bytes por segundo encolados por el productor en el ultimo periodo.",
+                             MEDIDOR_RITMO_ENTRADA);
+    exportar_medidor_fuentes(salida, "cola_ritmo_salida_bytes",
+                             "Bytes por segundo terminados por los consumidores en el ultimo periodo.",
+                             MEDIDOR_RITMO_SALIDA);
+    fprintf(salida, "# HELP toupperd_max_en_vuelo_bytes Presupuesto total de las colas (--max-inflight-bytes).\n");
+    fprintf(salida, "# TYPE toupperd_max_en_vuelo_bytes gauge\n");
+    fprintf(salida, "toupperd_max_en_vuelo_bytes %ld\n", g_max_en_vuelo);
+    fprintf(salida, "# HELP toupperd_fuentes Pares origen/destino atendidos.\n");
+    fprintf(salida, "# TYPE toupperd_fuentes gauge\n");
+    fprintf(salida, "toupperd_fuentes %d\n", g_num_fuentes);
+    fprintf(salida, "# HELP toupperd_pool_libres Entradas libres en el pool.\n");
+    fprintf(salida, "# TYPE toupperd_pool_libres gauge\n");
+    fprintf(salida, "toupperd_pool_libres %d\n", libres);
+    fprintf(salida, "# HELP toupperd_consumidores Hilos consumidores.\n");
+    fprintf(salida, "# TYPE toupperd_consumidores gauge\n");
+    fprintf(salida, "toupperd_consumidores %d\n", g_num_consumidores);
+    fprintf(salida, "# HELP toupperd_consumidores_dormidos Consumidores esperando trabajo.\n");
+    fprintf(salida, "# TYPE toupperd_consumidores_dormidos gauge\n");
+    fprintf(salida, "toupperd_consumidores_dormidos %d\n",
+            __atomic_load_n(&g_consumidores_dormidos, __ATOMIC_RELAXED));
+}
+
+// --- Configuración de las fuentes ---
+// Si `ruta` es `dir` o está dentro de él
+static int dentro_de(const char *ruta, const char *dir) {
+    size_t n = strlen(dir);
+    if (n == 1) {
+        return 1; // La raíz contiene todo
+    }
+    return strncmp(ruta, dir, n) == 0 && (ruta[n] == '/' || ruta[n] == '\0');
+}
+
+// Agrega un par origen -> destino. Las rutas se guardan resueltas, así dos
+// nombres distintos de la misma carpeta se detectan como la misma.
+static int agregar_fuente(const char *origen, const char *destino, int recursivo) {
+    char origen_real[PATH_MAX], destino_real[PATH_MAX];
+    if (realpath(origen, origen_real) == NULL) {
+        fprintf(stderr, "Error: carpeta de origen %s: %s\n", origen, strerror(errno));
+        return -1;
+    }
+    if (realpath(destino, destino_real) == NULL) {
+        fprintf(stderr, "Error: carpeta de destino %s: %s\n", destino, strerror(errno));
+        return -1;
+    }
+    if (strlen(origen_real) >= CARPETA_MAX || strlen(destino_real) >= CARPETA_MAX) {
+        fprintf(stderr, "Error: ruta demasiado larga: %s -> %s\n", origen, destino);
+        return -1;
+    }
+
+    // Un destino dentro de su propio origen volvería a procesar lo convertido
+    if (strcmp(origen_real, destino_real) == 0 || (recursivo && dentro_de(destino_real, origen_real))) {
+        fprintf(stderr, "Error: el destino %s está dentro del origen %s\n", destino, origen);
+        return -1;
+    }
+    // Cada destino tiene un solo diario, y cada origen un solo escáner
+    for (int i = 0; i < g_num_fuentes; i++) {
+        if (strcmp(g_fuentes[i].destino, destino_real) == 0) {
+            fprintf(stderr, "Error: el destino %s aparece en más de una fuente\n", destino);
+            return -1;
+        }
+        if (strcmp(g_fuentes[i].origen, origen_real) == 0) {
+            fprintf(stderr, "Error: el origen %s aparece en más de una fuente\n", origen);
+            return -1;
+        }
+    }
+
+    Fuente *fuentes = realloc(g_fuentes, (g_num_fuentes + 1) * sizeof(Fuente));
+    if (fuentes == NULL) {
+        perror("Error reservando memoria para las fuentes");
+        return -1;
+    }
+    g_fuentes = fuentes;
+    Fuente *f = &g_fuentes[g_num_fuentes++];
+    memset(f, 0, sizeof(*f));
+    strcpy(f->origen, origen_real);
+    strcpy(f->destino, destino_real);
+    f->recursivo = recursivo;
+    return 0;
+}
+
+// Lee el archivo de configuración de -f: una fuente por línea,
+//   <carpeta_origen> <carpeta_destino> [recursivo]
+// Las líneas vacías y lo que sigue a un # se ignoran.
+static int leer_configuracion(const char *archivo) {
+    FILE *cf = fopen(archivo, "r");
+    if (cf == NULL) {
+        fprintf(stderr, "Error abriendo la configuración %s: %s\n", archivo, strerror(errno));
+        return -1;
+    }
+
+    char linea[2 * RUTA_MAX + 64];
+    int numero = 0, error = 0;
+    while (!error && fgets(linea, sizeof(linea), cf) != NULL) {
+        numero++;
+        char *comentario = strchr(linea, '#');
+        if (comentario != NULL) {
+            *comentario = '\0';
+        }
+
+        char origen[RUTA_MAX], destino[RUTA_MAX], opcion[32], sobra;
+        int campos = sscanf(linea, "%1023s %1023s %31s %c", origen, destino, opcion, &sobra);
+        if (campos <= 0) {
+            continue; // Línea vacía
+        }
+        if (campos == 1 || campos == 4 || (campos == 3 && strcmp(opcion, "recursivo") != 0)) {
+            fprintf(stderr, "%s:%d: se esperaba '<carpeta_origen> <carpeta_destino> [recursivo]'\n",
+                    archivo, numero);
+            error = 1;
+            break;
+        }
+        error = agregar_fuente(origen, destino, campos == 3) != 0;
+    }
+    fclose(cf);
+
+    if (!error && g_num_fuentes == 0) {
+        fprintf(stderr, "%s: no hay ninguna fuente configurada\n", archivo);
+        error = 1;
+    }
+    return error ? -1 : 0;
+}
+
+// Inicializa la cola, el índice y el confirmador de una fuente, con su parte
+// del presupuesto de bytes en vuelo
+static int iniciar_fuente(Fuente *f) {
+    f->max_en_vuelo = g_max_en_vuelo / g_num_fuentes;
+    if (f->max_en_vuelo < LIMITE_MIN) {
+        f->max_en_vuelo = LIMITE_MIN;
+    }
+    f->limite = f->max_en_vuelo < LIMITE_INICIAL ? f->max_en_vuelo : LIMITE_INICIAL;
+    f->periodo_ns = metricas_ahora();
+
+    // Cada carril con lugar para todo el presupuesto en entradas mínimas, más
+    // la entrada que puede pasarse del límite
+    long entradas = f->max_en_vuelo / CARGO_MIN + 2;
+    for (int c = 0; c < CARRILES; c++) {
+        if (cola_iniciar(&f->colas[c], entradas < COLA_ENTRADAS_MAX ? entradas : COLA_ENTRADAS_MAX) != 0) {
+            return -1;
+        }
+    }
+
+    pthread_mutex_init(&f->ajuste_mutex, NULL);
+    pthread_mutex_init(&f->grandes_mutex, NULL);
+    pthread_cond_init(&f->grandes_cond, NULL);
+    f->grandes_ultimo = &f->grandes_primero;
+    pthread_mutex_init(&f->en_curso_mutex, NULL);
+    pthread_mutex_init(&f->confirmar_mutex, NULL);
+    pthread_cond_init(&f->confirmar_cond, NULL);
+    f->confirmar_ultimo = &f->confirmar_primero;
+    f->inotify = -1;
+    return indice_iniciar(&f->en_curso, EN_CURSO_INICIAL);
+}
+
+static void cerrar_fuente(Fuente *f) {
+    for (int c = 0; c < CARRILES; c++) {
+        cola_cerrar(&f->colas[c]);
+    }
+    pthread_mutex_destroy(&f->ajuste_mutex);
+    pthread_mutex_destroy(&f->grandes_mutex);
+    pthread_cond_destroy(&f->grandes_cond);
+    pthread_mutex_destroy(&f->en_curso_mutex);
+    pthread_mutex_destroy(&f->confirmar_mutex);
+    pthread_cond_destroy(&f->confirmar_cond);
+    indice_cerrar(&f->en_curso);
+    for (int i = 0; i < f->num_vigilados; i++) {
+        free(f->vigilados[i]);
+    }
+    free(f->vigilados);
+}
+
+// Lee una cantidad de bytes con sufijo opcional K, M o G (potencias de 1024).
+// Devuelve -1 si no es válida.
+static long leer_bytes(const char *texto) {
+    char *fin;
+    errno = 0;
+    long long valor = strtoll(texto, &fin, 10);
+    long long escala = 1;
+    switch (*fin) {
+    case 'k': case 'K': escala = 1024; fin++; break;
+    case 'm': case 'M': escala = 1024 * 1024; fin++; break;
+    case 'g': case 'G': escala = 1024 * 1024 * 1024; fin++; break;
+    }
+    if (errno != 0 || fin == texto || *fin != '\0' || valor <= 0 || valor > LONG_MAX / escala) {
+        return -1;
+    }
+    return (long) (valor * escala);
+}
+
+// Opciones largas; las que también tienen versión corta usan la misma letra
+enum { OPCION_MAX_EN_VUELO = 256 };
+
+static const struct option opciones_largas[] = {
+    { "max-inflight-bytes", required_argument, NULL, OPCION_MAX_EN_VUELO },
+    { NULL, 0, NULL, 0 },
+};
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        print_usage();
-        return 1;
+    int opt;
+    const char *metricas_direccion = NULL;
+    const char *configuracion = NULL;
+    int recursivo = 0;
+    int utf8 = 1;
+
+    while ((opt = getopt_long(argc, argv, "j:e:c:f:rM:v", opciones_largas, NULL)) != -1) {
+        switch (opt) {
+        case OPCION_MAX_EN_VUELO:
+            g_max_en_vuelo = leer_bytes(optarg);
+            if (g_max_en_vuelo < 0) {
+                fprintf(stderr, "Error: tamaño inválido '%s' para --max-inflight-bytes.\n", optarg);
+                return 1;
+            }
+            if (g_max_en_vuelo < LIMITE_MIN) {
+                fprintf(stderr, "Error: --max-inflight-bytes debe ser al menos %ldK.\n", LIMITE_MIN / 1024);
+                return 1;
+            }
+            break;
+        case 'j':
+            g_num_consumidores = atoi(optarg);
+            if (g_num_consumidores <= 0) {
+                fprintf(stderr, "Error: -j debe ser mayor que 0.\n");
+                return 1;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "stdio") == 0) {
+                g_motor = MOTOR_STDIO;
+            } else if (strcmp(optarg, "mmap") == 0) {
+                g_motor = MOTOR_MMAP;
+            } else {
+                fprintf(stderr, "Error: motor de E/S desconocido '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            if (strcmp(optarg, "utf8") == 0) {
+                utf8 = 1;
+            } else if (strcmp(optarg, "ascii") == 0) {
+                utf8 = 0;
+            } else {
+                fprintf(stderr, "Error: codificación desconocida '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            configuracion = optarg;
+            break;
+        case 'r':
+            recursivo = 1;
+            break;
+        case 'M':
+            metricas_direccion = optarg;
+            break;
+        case 'v':
+            g_verboso = 1;
+            break;
+        default:
+            print_usage();
+            return 1;
+        }
     }
-    
-    g_origen_path = argv[1];
-    g_destino_path = argv[2];
+
+    // Las fuentes salen de -f, o del par de carpetas de la línea de comandos
+    if (configuracion != NULL) {
+        if (argc != optind || recursivo) {
+            fprintf(stderr, "Error: con -f las carpetas (y recursivo) van en la configuración.\n");
+            return 1;
+        }
+        if (leer_configuracion(configuracion) != 0) {
+            return 1;
+        }
+    } else {
+        if (argc - optind != 2) {
+            print_usage();
+            return 1;
+        }
+        if (agregar_fuente(argv[optind], argv[optind + 1], recursivo) != 0) {
+            return 1;
+        }
+    }
+
+    // Por defecto, un consumidor por CPU en línea
+    if (g_num_consumidores == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_num_consumidores = cpus > 0 ? (int) cpus : 1;
+    }
+
+    // Elegir la variante del núcleo de conversión según la CPU
+    const char *variante = mayus_iniciar(utf8);
 
     // 1. Inicializar mecanismos de sincronización
-    sem_init(&sem_full, 0, 0); // 0 elementos llenos
-    sem_init(&sem_empty, 0, BUFFER_SIZE); // 5 elementos vacíos
-    pthread_mutex_init(&buffer_mutex, NULL);
-    
-    pthread_t productor_tid, consumidor_tid;
-    
-    // 2. Crear los hilos
-    if (pthread_create(&productor_tid, NULL, hilo_productor, NULL) != 0) {
-        perror("Error creando hilo productor");
+    for (int i = 0; i < g_num_fuentes; i++) {
+        if (iniciar_fuente(&g_fuentes[i]) != 0) {
+            perror("Error reservando memoria para la cola y el índice de una fuente");
+            return 1;
+        }
+    }
+    pthread_mutex_init(&pool_mutex, NULL);
+
+    pthread_t *consumidor_tids = malloc(g_num_consumidores * sizeof(pthread_t));
+    if (consumidor_tids == NULL) {
+        perror("Error reservando memoria para los consumidores");
         return 1;
     }
-    
-    if (pthread_create(&consumidor_tid, NULL, hilo_consumidor, NULL) != 0) {
-        perror("Error creando hilo consumidor");
+
+    // Motor mmap: un origen truncado mientras está mapeado hace fallar su
+    // trabajo, no el servicio
+    if (g_motor == MOTOR_MMAP) {
+        instalar_sigbus();
+    }
+
+    // Endpoint de métricas. Un cliente que corta la conexión no debe matar el
+    // servicio con SIGPIPE: los errores de escritura se manejan donde ocurren
+    signal(SIGPIPE, SIG_IGN);
+    if (metricas_direccion != NULL && metricas_servir(metricas_direccion, exportar_medidores) != 0) {
+        fprintf(stderr, "Error abriendo el endpoint de métricas %s: %s\n", metricas_direccion, strerror(errno));
         return 1;
     }
+
+    // Rehacer lo que quedó a medias si el servicio se cayó, antes de escanear
+    for (int i = 0; i < g_num_fuentes; i++) {
+        Fuente *f = &g_fuentes[i];
+        int rehechas = diario_abrir(&f->diario, f->origen, f->destino);
+        if (rehechas < 0) {
+            fprintf(stderr, "Error abriendo el diario en %s: %s\n", f->destino, strerror(errno));
+            return 1;
+        }
+        if (rehechas > 0) {
+            printf("Diario: %d archivos de %s confirmados antes de la caída fueron completados.\n",
+                   rehechas, f->origen);
+        }
+    }
+
+    // 2. Crear los hilos: un productor, un lector de grandes y un confirmador
+    //    por fuente
+    for (int i = 0; i < g_num_fuentes; i++) {
+        if (pthread_create(&g_fuentes[i].productor_tid, NULL, hilo_productor, &g_fuentes[i]) != 0) {
+            perror("Error creando hilo productor");
+            return 1;
+        }
+        if (pthread_create(&g_fuentes[i].lector_tid, NULL, hilo_lector, &g_fuentes[i]) != 0) {
+            perror("Error creando hilo lector");
+            return 1;
+        }
+        if (pthread_create(&g_fuentes[i].confirmador_tid, NULL, hilo_confirmador, &g_fuentes[i]) != 0) {
+            perror("Error creando hilo confirmador");
+            return 1;
+        }
+    }
     
-    printf("toupperd iniciado. Origen: %s, Destino: %s\n", g_origen_path, g_destino_path);
+    for (int i = 0; i < g_num_consumidores; i++) {
+        if (pthread_create(&consumidor_tids[i], NULL, hilo_consumidor, NULL) != 0) {
+            perror("Error creando hilo consumidor");
+            return 1;
+        }
+    }
+
+    printf("toupperd iniciado. Fuentes: %d, Consumidores: %d, Motor: %s, Conversión: %s (%s)\n",
+           g_num_fuentes, g_num_consumidores,
+           nombres_motor[g_motor], utf8 ? "utf8" : "ascii", variante);
+    for (int i = 0; i < g_num_fuentes; i++) {
+        printf("  Origen: %s, Destino: %s%s\n", g_fuentes[i].origen, g_fuentes[i].destino,
+               g_fuentes[i].recursivo ? " (recursivo)" : "");
+    }
     printf("Presiona Ctrl+C para detener el servicio.\n");
 
     // 3. Esperar indefinidamente
-    pthread_join(productor_tid, NULL);
-    pthread_join(consumidor_tid, NULL);
+    for (int i = 0; i < g_num_fuentes; i++) {
+        pthread_join(g_fuentes[i].productor_tid, NULL);
+        pthread_join(g_fuentes[i].lector_tid, NULL);
+    }
+    for (int i = 0; i < g_num_consumidores; i++) {
+        pthread_join(consumidor_tids[i], NULL);
+    }
+    for (int i = 0; i < g_num_fuentes; i++) {
+        pthread_join(g_fuentes[i].confirmador_tid, NULL);
+    }
 
     // 4. Limpieza (nunca se alcanzará en un daemon/servicio, pero es buena práctica)
-    sem_destroy(&sem_full);
-    sem_destroy(&sem_empty);
-    pthread_mutex_destroy(&buffer_mutex);
+    for (int i = 0; i < g_num_fuentes; i++) {
+        cerrar_fuente(&g_fuentes[i]);
+    }
+    free(g_fuentes);
+    pthread_mutex_destroy(&pool_mutex);
+    for (int i = 0; i < CLASES_POOL; i++) {
+        while (pool_libres[i] != NULL) {
+            FileData *e = pool_libres[i];
+            pool_libres[i] = e->siguiente_libre;
+            free(e);
+        }
+    }
+    free(consumidor_tids);
 
     return 0;
 }